@@ -25,12 +25,30 @@ import android.util.Log;
 import android.view.View;
 import android.widget.Toast;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
 
 public class NativeEglExample extends Activity implements SurfaceHolder.Callback
 {
 
     private static String TAG = "EglSample";
 
+    // Layout of a native ingest slot, see IngestSlot in ingest.h
+    private static final int INGEST_INSTANCE_COUNT = 0;
+    private static final int INGEST_PARAM_COUNT = 4;
+    private static final int INGEST_PARAMS = 16;
+    private static final int INGEST_INSTANCES = 80;
+    private static final int INGEST_INSTANCE_SIZE = 32;
+    private static final int INGEST_MAX_INSTANCES = 4096;
+
+    private static final int SCENE_GRID = 48;
+    private static final float SCENE_EXTENT = 1.5f;
+    private static final float SCENE_SCALE = 0.025f;
+
+    private Thread mProducer;
+    private volatile boolean mProducing;
+
     @Override
     public void onCreate(Bundle savedInstanceState) {
         super.onCreate(savedInstanceState);
@@ -42,7 +60,7 @@ public class NativeEglExample extends Activity implements SurfaceHolder.Callback
         surfaceView.getHolder().addCallback(this);
         surfaceView.setOnClickListener(new View.OnClickListener() {
                 public void onClick(View view) {
-          //          nativeChangeMode();
+                    nativeChangeMode();
                     Toast toast = Toast.makeText(NativeEglExample.this,
                                                  "This demo combines Java UI and native EGL + OpenGL renderer",
                                                  Toast.LENGTH_LONG);
@@ -62,12 +80,14 @@ public class NativeEglExample extends Activity implements SurfaceHolder.Callback
         super.onResume();
         Log.i(TAG, "onResume()");
         nativeOnResume();
+        startProducer();
     }
     
     @Override
     protected void onPause() {
         super.onPause();
         Log.i(TAG, "onPause()");
+        stopProducer();
         nativeOnPause();
     }
 
@@ -89,6 +109,60 @@ public class NativeEglExample extends Activity implements SurfaceHolder.Callback
         nativeSetSurface(null);
     }
 
+    // Feeds the native scene through the ingest triple buffer: each update
+    // is written straight into native memory and published with one call.
+    private void startProducer() {
+        mProducing = true;
+        mProducer = new Thread(new Runnable() {
+                public void run() {
+                    long start = System.nanoTime();
+                    while (mProducing) {
+                        float t = (System.nanoTime() - start) / 1e9f;
+                        ByteBuffer slot = nativeIngestAcquire();
+                        if (slot != null) {
+                            writeScene(slot.order(ByteOrder.nativeOrder()), t);
+                            nativeIngestPublish(slot);
+                        }
+                        try {
+                            Thread.sleep(33);
+                        } catch (InterruptedException e) {
+                            return;
+                        }
+                    }
+                }});
+        mProducer.start();
+    }
+
+    private void stopProducer() {
+        mProducing = false;
+        try {
+            mProducer.join();
+        } catch (InterruptedException e) {
+        }
+        mProducer = null;
+    }
+
+    private static void writeScene(ByteBuffer slot, float t) {
+        int count = Math.min(SCENE_GRID * SCENE_GRID, INGEST_MAX_INSTANCES);
+        slot.putInt(INGEST_INSTANCE_COUNT, count);
+        slot.putInt(INGEST_PARAM_COUNT, 4);
+        slot.putFloat(INGEST_PARAMS, 0.2f);
+        slot.putFloat(INGEST_PARAMS + 4, 0.4f + 0.3f * (float)Math.sin(t));
+        slot.putFloat(INGEST_PARAMS + 8, 1.0f);
+        slot.putFloat(INGEST_PARAMS + 12, 1.0f);
+        for (int i = 0; i < count; i++) {
+            int o = INGEST_INSTANCES + i * INGEST_INSTANCE_SIZE;
+            float x = -SCENE_EXTENT + 2.0f * SCENE_EXTENT * (i % SCENE_GRID) / (SCENE_GRID - 1);
+            float y = -SCENE_EXTENT + 2.0f * SCENE_EXTENT * (i / SCENE_GRID) / (SCENE_GRID - 1);
+            float r = SCENE_SCALE * (1.0f + 0.5f * (float)Math.sin(t * 2.0f + x * 3.0f + y * 2.0f));
+            slot.putFloat(o, x);
+            slot.putFloat(o + 4, y);
+            slot.putFloat(o + 8, 0.0f);
+            slot.putFloat(o + 12, r);
+            slot.putInt(o + 16, 0);
+        }
+    }
+
 
     public static native void nativeOnStart();
     public static native void nativeOnResume();
@@ -96,6 +170,8 @@ public class NativeEglExample extends Activity implements SurfaceHolder.Callback
     public static native void nativeOnStop();
     public static native void nativeSetSurface(Surface surface);
     public static native void nativeChangeMode();
+    public static native ByteBuffer nativeIngestAcquire();
+    public static native boolean nativeIngestPublish(ByteBuffer buffer);
 
     static {
         System.loadLibrary("nativeegl");
@@ -14,3 +14,25 @@ static float squareCoords[]={
         0.0f, 1.0f, 0.0f, //top right
 };
 
+
+// two triangles over squareCoords; the shape fits inside the unit sphere,
+// so an instance scaled by s has a bounding radius of s
+static unsigned short squareIndices[]={
+        0, 1, 2,
+        0, 2, 3,
+};
+
+// culling test scene: a grid of scaled squares, wider than the viewport
+#define SCENE_GRID 48
+#define SCENE_EXTENT 1.5f
+#define SCENE_SCALE 0.025f
+
+// LOD selection: largest geometric error allowed on screen, and the most
+// triangles the scene may submit per frame
+#define SCENE_LOD_THRESHOLD 1.0f
+#define SCENE_TRIANGLE_BUDGET 200000
+
+// mesh drawn instead of the square when present, written by tools/meshconv
+#ifndef SCENE_MESH_PATH
+#define SCENE_MESH_PATH "/data/data/tsaarni.nativeeglexample/files/scene.mesh"
+#endif
@@ -0,0 +1,586 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <GLES3/gl31.h>
+
+#include "logger.h"
+#include "culling.h"
+#include "glcapture.h"
+
+#define LOG_TAG "EglSample"
+
+#define CULL_GROUP_SIZE 64
+
+// the shader spells these out
+static_assert(CULL_MAX_LEVELS == 8 && CULL_LOD_STEPS == 64 && CULL_SCALE_BINS == 64 && CULL_LEVEL_NONE == 0xff, "cull shader constants");
+static_assert(sizeof(CullHeader) == 584 && sizeof(CullCommand) == 24, "cull shader layout");
+
+// Pass 0 (LOD selection only) tests every object, stores its pixel scale
+// (-1 when culled), counts objects per scale bin and adds up the triangles
+// each threshold step would draw; pass 1 picks the levels, or takes the
+// batch from the object, and appends the survivors.
+const char *cullComputeSrc =
+        "#version 310 es                                                        \n"
+                "precision highp float;                                         \n"
+                "layout(local_size_x = 64) in;                                  \n"
+                "const uint LOD_STEPS = 64u;                                    \n"
+                "const uint SCALE_BINS = 64u;                                   \n"
+                "const uint LEVEL_NONE = 255u;                                  \n"
+                "struct Object { vec4 sphere; uint batch; uint pad0; uint pad1; uint pad2; };\n"
+                "struct Command { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint reserved; uint firstInstance; };\n"
+                "struct ObjectLod { float scale; uint level; };                 \n"
+                "layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+                "layout(std430, binding = 1) buffer Commands {                  \n"
+                "  uint stepTriangles[LOD_STEPS + 1u];                          \n"
+                "  uint scaleCount[SCALE_BINS];                                 \n"
+                "  uint admitted;                                               \n"
+                "  float levelError[8];                                         \n"
+                "  uint levelTriangles[8];                                      \n"
+                "  Command commands[];                                          \n"
+                "};                                                             \n"
+                "layout(std430, binding = 2) writeonly buffer Instances { vec4 instances[]; };\n"
+                "layout(std430, binding = 3) buffer ObjectLods { ObjectLod objectLods[]; };\n"
+                "uniform vec4 uPlanes[6];                                       \n"
+                "uniform mat4 uViewProj;                                        \n"
+                "uniform uint uObjectCount;                                     \n"
+                "uniform uint uBatchCount;                                      \n"
+                "uniform bool uUseHiZ;                                          \n"
+                "uniform highp sampler2D uHiZ;                                  \n"
+                "uniform vec2 uHiZSize;                                         \n"
+                "uniform float uHiZLevels;                                      \n"
+                "uniform uint uPass;                                            \n"
+                "uniform uint uLevelCount;                                      \n"
+                "uniform float uThreshold;                                      \n"
+                "uniform float uHysteresis;                                     \n"
+                "uniform float uPixelScale;                                     \n"
+                "uniform uint uBudget;                                          \n"
+                "shared uint groupTriangles[LOD_STEPS + 1u];                    \n"
+                "shared uint groupScales[SCALE_BINS];                           \n"
+                "bool occluded(vec3 c, float r) {                               \n"
+                "  vec2 lo = vec2(1.0);                                         \n"
+                "  vec2 hi = vec2(-1.0);                                        \n"
+                "  float zNear = 1.0;                                           \n"
+                "  for (int i = 0; i < 8; ++i) {                                \n"
+                "    vec3 s = vec3((i & 1) != 0 ? 1.0 : -1.0,                   \n"
+                "                  (i & 2) != 0 ? 1.0 : -1.0,                   \n"
+                "                  (i & 4) != 0 ? 1.0 : -1.0);                  \n"
+                "    vec4 p = uViewProj * vec4(c + r * s, 1.0);                 \n"
+                "    if (p.w <= 0.0) return false;                              \n"
+                "    vec3 ndc = p.xyz / p.w;                                    \n"
+                "    lo = min(lo, ndc.xy);                                      \n"
+                "    hi = max(hi, ndc.xy);                                      \n"
+                "    zNear = min(zNear, ndc.z);                                 \n"
+                "  }                                                            \n"
+                "  lo = clamp(lo * 0.5 + 0.5, 0.0, 1.0);                        \n"
+                "  hi = clamp(hi * 0.5 + 0.5, 0.0, 1.0);                        \n"
+                "  vec2 extent = (hi - lo) * uHiZSize;                          \n"
+                "  float level = clamp(ceil(log2(max(max(extent.x, extent.y), 1.0))), 0.0, uHiZLevels - 1.0);\n"
+                "  float d = max(max(textureLod(uHiZ, lo, level).r,             \n"
+                "                    textureLod(uHiZ, vec2(hi.x, lo.y), level).r),\n"
+                "                max(textureLod(uHiZ, vec2(lo.x, hi.y), level).r,\n"
+                "                    textureLod(uHiZ, hi, level).r));           \n"
+                "  return zNear * 0.5 + 0.5 > d;                                \n"
+                "}                                                              \n"
+                "bool inView(vec4 s) {                                          \n"
+                "  for (int p = 0; p < 6; ++p) {                                \n"
+                "    if (dot(uPlanes[p].xyz, s.xyz) + uPlanes[p].w < -s.w) return false;\n"
+                "  }                                                            \n"
+                "  return !(uUseHiZ && occluded(s.xyz, s.w));                   \n"
+                "}                                                              \n"
+                "float stepThreshold(uint k) {                                  \n"
+                "  return uThreshold * exp2(0.25 * float(k));                   \n"
+                "}                                                              \n"
+                "// as LodSelector::choose: the coarsest level under the threshold,\n"
+                "// but leaving last frame's finer level only with some margin   \n"
+                "uint levelFor(float scale, float threshold, uint previous) {   \n"
+                "  uint desired = 0u;                                           \n"
+                "  for (uint l = uLevelCount - 1u; l > 0u; --l) {               \n"
+                "    if (levelError[l] * scale <= threshold) { desired = l; break; }\n"
+                "  }                                                            \n"
+                "  if (previous == LEVEL_NONE || previous >= desired) return desired;\n"
+                "  float coarsen = threshold * (1.0 - uHysteresis);             \n"
+                "  for (uint l = desired; l > previous; --l) {                  \n"
+                "    if (levelError[l] * scale <= coarsen) return l;            \n"
+                "  }                                                            \n"
+                "  return previous;                                             \n"
+                "}                                                              \n"
+                "// half octaves of pixel scale, 2^-16 to 2^16                   \n"
+                "uint scaleBin(float scale) {                                   \n"
+                "  return uint(clamp(floor(2.0 * log2(max(scale, 1e-30))) + 32.0, 0.0, float(SCALE_BINS - 1u)));\n"
+                "}                                                              \n"
+                "// At the coarsest level and still over budget only the objects\n"
+                "// largest on screen fit: whole scale bins from the top, then  \n"
+                "// first come first served in the bin that crosses the budget  \n"
+                "bool fitsBudget(float scale) {                                 \n"
+                "  uint t = levelTriangles[uLevelCount - 1u];                   \n"
+                "  if (t == 0u) return true;                                    \n"
+                "  uint keep = uBudget / t;                                     \n"
+                "  uint bin = scaleBin(scale);                                  \n"
+                "  uint above = 0u;                                             \n"
+                "  for (uint k = SCALE_BINS - 1u; k > bin; --k) above += scaleCount[k];\n"
+                "  if (above + scaleCount[bin] <= keep) return true;            \n"
+                "  if (above >= keep) return false;                             \n"
+                "  return atomicAdd(admitted, 1u) < keep - above;               \n"
+                "}                                                              \n"
+                "void measure(uint i) {                                         \n"
+                "  if (i >= uObjectCount) return;                               \n"
+                "  vec4 s = objects[i].sphere;                                  \n"
+                "  if (!inView(s)) {                                            \n"
+                "    objectLods[i].scale = -1.0;                                \n"
+                "    return;                                                    \n"
+                "  }                                                            \n"
+                "  // pixels per unit of error, clamped inside the sphere so it \n"
+                "  // stays finite and a raised threshold still coarsens        \n"
+                "  float d = max((uViewProj * vec4(s.xyz, 1.0)).w, s.w);        \n"
+                "  float scale = d > 0.0 ? s.w * uPixelScale / d : 0.0;         \n"
+                "  objectLods[i].scale = scale;                                 \n"
+                "  if (uBudget == 0u) return;                                   \n"
+                "  atomicAdd(groupScales[scaleBin(scale)], 1u);                 \n"
+                "  uint previous = objectLods[i].level;                         \n"
+                "  for (uint k = 0u; k < LOD_STEPS; ++k) {                      \n"
+                "    atomicAdd(groupTriangles[k], levelTriangles[levelFor(scale, stepThreshold(k), previous)]);\n"
+                "  }                                                            \n"
+                "  atomicAdd(groupTriangles[LOD_STEPS], levelTriangles[uLevelCount - 1u]);\n"
+                "}                                                              \n"
+                "void emit(uint i) {                                            \n"
+                "  if (i >= uObjectCount) return;                               \n"
+                "  vec4 s = objects[i].sphere;                                  \n"
+                "  uint b;                                                      \n"
+                "  if (uLevelCount == 0u) {                                     \n"
+                "    b = objects[i].batch;                                      \n"
+                "    if (b >= uBatchCount || !inView(s)) return;                \n"
+                "  } else {                                                     \n"
+                "    float scale = objectLods[i].scale;                         \n"
+                "    if (scale < 0.0) {                                         \n"
+                "      objectLods[i].level = LEVEL_NONE;                        \n"
+                "      return;                                                  \n"
+                "    }                                                          \n"
+                "    // the first step within budget, the same for every object;\n"
+                "    // past the last one everything drops to the coarsest level,\n"
+                "    // and what still does not fit is not drawn               \n"
+                "    uint step = 0u;                                            \n"
+                "    if (uBudget > 0u) {                                        \n"
+                "      step = LOD_STEPS;                                        \n"
+                "      for (uint k = 0u; k < LOD_STEPS; ++k) {                  \n"
+                "        if (stepTriangles[k] <= uBudget) { step = k; break; }  \n"
+                "      }                                                        \n"
+                "    }                                                          \n"
+                "    if (step < LOD_STEPS) {                                    \n"
+                "      b = levelFor(scale, stepThreshold(step), objectLods[i].level);\n"
+                "    } else if (fitsBudget(scale)) {                            \n"
+                "      b = uLevelCount - 1u;                                    \n"
+                "    } else {                                                   \n"
+                "      objectLods[i].level = LEVEL_NONE;                        \n"
+                "      return;                                                  \n"
+                "    }                                                          \n"
+                "    objectLods[i].level = b;                                   \n"
+                "  }                                                            \n"
+                "  uint slot = atomicAdd(commands[b].instanceCount, 1u);        \n"
+                "  instances[commands[b].firstInstance + slot] = s;             \n"
+                "}                                                              \n"
+                "void main() {                                                  \n"
+                "  uint t = gl_LocalInvocationIndex;                            \n"
+                "  for (uint k = t; k <= LOD_STEPS; k += gl_WorkGroupSize.x) groupTriangles[k] = 0u;\n"
+                "  for (uint k = t; k < SCALE_BINS; k += gl_WorkGroupSize.x) groupScales[k] = 0u;\n"
+                "  memoryBarrierShared();                                       \n"
+                "  barrier();                                                   \n"
+                "  if (uPass == 0u) measure(gl_GlobalInvocationID.x);           \n"
+                "  else emit(gl_GlobalInvocationID.x);                          \n"
+                "  memoryBarrierShared();                                       \n"
+                "  barrier();                                                   \n"
+                "  // one global atomic per counter and group                   \n"
+                "  if (uPass == 0u) {                                           \n"
+                "    for (uint k = t; k <= LOD_STEPS; k += gl_WorkGroupSize.x) {\n"
+                "      if (groupTriangles[k] != 0u) atomicAdd(stepTriangles[k], groupTriangles[k]);\n"
+                "    }                                                          \n"
+                "    for (uint k = t; k < SCALE_BINS; k += gl_WorkGroupSize.x) {\n"
+                "      if (groupScales[k] != 0u) atomicAdd(scaleCount[k], groupScales[k]);\n"
+                "    }                                                          \n"
+                "  }                                                            \n"
+                "}                                                              \n";
+
+void extractFrustumPlanes(const GLfloat m[16], GLfloat planes[24]) {
+    // row r of a column-major matrix is (m[r], m[4 + r], m[8 + r], m[12 + r])
+    for (int i = 0; i < 6; i++) {
+        int row = i / 2;
+        GLfloat sign = (i & 1) ? -1.0f : 1.0f;
+        GLfloat *p = planes + i * 4;
+        for (int c = 0; c < 4; c++) {
+            p[c] = m[c * 4 + 3] + sign * m[c * 4 + row];
+        }
+        GLfloat len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        if (len > 0.0f) {
+            for (int c = 0; c < 4; c++) {
+                p[c] /= len;
+            }
+        }
+    }
+}
+
+bool sphereInFrustum(const GLfloat planes[24], const GLfloat center[3], GLfloat radius) {
+    for (int i = 0; i < 6; i++) {
+        const GLfloat *p = planes + i * 4;
+        if (p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3] < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+GpuCuller::GpuCuller()
+        : m_program(0), m_objectBuffer(0), m_commandBuffer(0), m_instanceBuffer(0), m_lodBuffer(0),
+          m_uPlanes(-1), m_uViewProj(-1), m_uObjectCount(-1), m_uBatchCount(-1), m_uUseHiZ(-1),
+          m_uHiZ(-1), m_uHiZSize(-1), m_uHiZLevels(-1), m_uPass(-1), m_uLevelCount(-1),
+          m_uThreshold(-1), m_uHysteresis(-1), m_uPixelScale(-1), m_uBudget(-1),
+          m_objectCount(0), m_instanceCapacity(0), m_batchCount(0), m_batchFirstInstance(0), m_commands(0),
+          m_levelCount(0), m_threshold(0.0f), m_hysteresis(0.0f), m_budget(0),
+          m_hiZ(0), m_hiZLevels(0), m_hiZWidth(0), m_hiZHeight(0) {
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+GpuCuller::~GpuCuller() {
+    delete[] m_batchFirstInstance;
+    delete[] m_commands;
+}
+
+bool GpuCuller::initialize(const CullObject *objects, GLuint objectCount,
+                           const CullBatch *batches, GLuint batchCount) {
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &cullComputeSrc, 0);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE) {
+        GLchar msg[4096];
+        glGetShaderInfoLog(shader, sizeof(msg), 0, msg);
+        LOG_ERROR("Compiling cull shader failed\n%s\n", msg);
+        glDeleteShader(shader);
+        return false;
+    }
+
+    m_program = glCreateProgram();
+    glAttachShader(m_program, shader);
+    glLinkProgram(m_program);
+    glDetachShader(m_program, shader);
+    glDeleteShader(shader);
+
+    glGetProgramiv(m_program, GL_LINK_STATUS, &status);
+    if (!status) {
+        GLchar msg[4096];
+        glGetProgramInfoLog(m_program, sizeof(msg), 0, msg);
+        LOG_ERROR("Linking cull program failed\n%s\n", msg);
+        glDeleteProgram(m_program);
+        m_program = 0;
+        return false;
+    }
+
+    m_uPlanes = glGetUniformLocation(m_program, "uPlanes");
+    m_uViewProj = glGetUniformLocation(m_program, "uViewProj");
+    m_uObjectCount = glGetUniformLocation(m_program, "uObjectCount");
+    m_uBatchCount = glGetUniformLocation(m_program, "uBatchCount");
+    m_uUseHiZ = glGetUniformLocation(m_program, "uUseHiZ");
+    m_uHiZ = glGetUniformLocation(m_program, "uHiZ");
+    m_uHiZSize = glGetUniformLocation(m_program, "uHiZSize");
+    m_uHiZLevels = glGetUniformLocation(m_program, "uHiZLevels");
+    m_uPass = glGetUniformLocation(m_program, "uPass");
+    m_uLevelCount = glGetUniformLocation(m_program, "uLevelCount");
+    m_uThreshold = glGetUniformLocation(m_program, "uThreshold");
+    m_uHysteresis = glGetUniformLocation(m_program, "uHysteresis");
+    m_uPixelScale = glGetUniformLocation(m_program, "uPixelScale");
+    m_uBudget = glGetUniformLocation(m_program, "uBudget");
+
+    m_batchCount = batchCount;
+    m_batchFirstInstance = new GLuint[batchCount];
+    m_commands = new CullCommand[batchCount];
+    for (GLuint b = 0; b < batchCount; b++) {
+        m_commands[b].draw.count = batches[b].indexCount;
+        m_commands[b].draw.instanceCount = 0;
+        m_commands[b].draw.firstIndex = batches[b].firstIndex;
+        m_commands[b].draw.baseVertex = 0;
+        m_commands[b].draw.reservedMustBeZero = 0;
+        m_commands[b].firstInstance = 0;
+    }
+
+    glGenBuffers(1, &m_objectBuffer);
+    glGenBuffers(1, &m_instanceBuffer);
+    glGenBuffers(1, &m_lodBuffer);
+    glGenBuffers(1, &m_commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CullHeader) + batchCount * sizeof(CullCommand), 0, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    setObjects(objects, objectCount);
+    LOG_INFO("GpuCuller: %u objects in %u batches", objectCount, batchCount);
+    return true;
+}
+
+void GpuCuller::setObjects(const CullObject *objects, GLuint objectCount) {
+    if (!m_program) {
+        return;
+    }
+
+    bool resized = objectCount != m_objectCount;
+    m_objectCount = objectCount;
+    layoutBatches(objects, objectCount);
+
+    // a fresh store rather than an update in place, which would have to
+    // wait for last frame's dispatch to stop reading the old objects
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objectCount * sizeof(CullObject), objects, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (resized) {
+        resetLod();
+    }
+}
+
+bool GpuCuller::setLod(const GLfloat *errors, GLfloat threshold, GLfloat hysteresis, GLuint budget) {
+    if (!m_program) {
+        return false;
+    }
+    if (!m_batchCount || m_batchCount > CULL_MAX_LEVELS) {
+        LOG_ERROR("GpuCuller: LOD selection needs 1 to %d batches, got %u", CULL_MAX_LEVELS, m_batchCount);
+        return false;
+    }
+
+    m_levelCount = m_batchCount;
+    for (GLuint l = 0; l < m_levelCount; l++) {
+        m_header.levelError[l] = errors[l];
+        m_header.levelTriangles[l] = m_commands[l].draw.count / 3;
+    }
+    m_threshold = threshold;
+    m_hysteresis = hysteresis;
+    m_budget = budget;
+
+    // any level can now take any object
+    layoutBatches(0, m_objectCount);
+    resetLod();
+    LOG_INFO("GpuCuller: %u LOD levels, budget %u triangles", m_levelCount, budget);
+    return true;
+}
+
+// Each batch owns a contiguous slice of the instance buffer large enough
+// for every object it can receive, so survivors never overflow: its own
+// objects, or with LOD selection all of them.
+void GpuCuller::layoutBatches(const CullObject *objects, GLuint objectCount) {
+    for (GLuint b = 0; b < m_batchCount; b++) {
+        m_batchFirstInstance[b] = m_levelCount ? objectCount : 0;
+    }
+    if (!m_levelCount) {
+        for (GLuint i = 0; i < objectCount; i++) {
+            if (objects[i].batch < m_batchCount) {
+                m_batchFirstInstance[objects[i].batch]++;
+            }
+        }
+    }
+    GLuint first = 0;
+    for (GLuint b = 0; b < m_batchCount; b++) {
+        GLuint n = m_batchFirstInstance[b];
+        m_batchFirstInstance[b] = first;
+        m_commands[b].firstInstance = first;
+        first += n;
+    }
+
+    if (first > m_instanceCapacity) {
+        m_instanceCapacity = first;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, first * 4 * sizeof(GLfloat), 0, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+}
+
+// Forgets last frame's levels, for a new object set or new levels.
+void GpuCuller::resetLod() {
+    GLuint *lods = new GLuint[m_objectCount * 2 + 2];
+    for (GLuint i = 0; i < m_objectCount; i++) {
+        lods[i * 2] = 0;
+        lods[i * 2 + 1] = CULL_LEVEL_NONE;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lodBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_objectCount * 2 * sizeof(GLuint), lods, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    delete[] lods;
+}
+
+void GpuCuller::destroy() {
+    glDeleteBuffers(1, &m_objectBuffer);
+    glDeleteBuffers(1, &m_commandBuffer);
+    glDeleteBuffers(1, &m_instanceBuffer);
+    glDeleteBuffers(1, &m_lodBuffer);
+    glDeleteProgram(m_program);
+    m_objectBuffer = 0;
+    m_commandBuffer = 0;
+    m_instanceBuffer = 0;
+    m_lodBuffer = 0;
+    m_program = 0;
+
+    delete[] m_batchFirstInstance;
+    delete[] m_commands;
+    m_batchFirstInstance = 0;
+    m_commands = 0;
+    m_objectCount = 0;
+    m_instanceCapacity = 0;
+    m_batchCount = 0;
+    m_levelCount = 0;
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+void GpuCuller::setHiZ(GLuint texture, GLint levels, GLint width, GLint height) {
+    m_hiZ = texture;
+    m_hiZLevels = levels;
+    m_hiZWidth = width;
+    m_hiZHeight = height;
+}
+
+void GpuCuller::cull(const GLfloat viewProj[16], GLfloat pixelScale) {
+    if (!m_program || !m_objectCount) {
+        return;
+    }
+
+    GLfloat planes[24];
+    extractFrustumPlanes(viewProj, planes);
+
+    // reset counters and instance counts; the barrier at the end of last
+    // frame's cull() orders this after its shader writes
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CullHeader), &m_header);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(CullHeader), m_batchCount * sizeof(CullCommand), m_commands);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(m_program);
+    glUniform4fv(m_uPlanes, 6, planes);
+    glUniformMatrix4fv(m_uViewProj, 1, GL_FALSE, viewProj);
+    glUniform1ui(m_uObjectCount, m_objectCount);
+    glUniform1ui(m_uBatchCount, m_batchCount);
+    glUniform1i(m_uUseHiZ, m_hiZ != 0);
+    if (m_hiZ) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_hiZ);
+        glUniform1i(m_uHiZ, 0);
+        glUniform2f(m_uHiZSize, (GLfloat) m_hiZWidth, (GLfloat) m_hiZHeight);
+        glUniform1f(m_uHiZLevels, (GLfloat) m_hiZLevels);
+    }
+    glUniform1ui(m_uLevelCount, m_levelCount);
+    if (m_levelCount) {
+        glUniform1f(m_uThreshold, m_threshold);
+        glUniform1f(m_uHysteresis, m_hysteresis);
+        glUniform1f(m_uPixelScale, pixelScale);
+        glUniform1ui(m_uBudget, m_budget);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_lodBuffer);
+
+    GLuint groups = (m_objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+    if (m_levelCount) {
+        glUniform1ui(m_uPass, 0);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    glUniform1ui(m_uPass, 1);
+    glDispatchCompute(groups, 1, 1);
+    // the draws read the commands and instances; next frame's reset and
+    // pass 0 write and read what the shader wrote here
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                    GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (m_hiZ) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+void GpuCuller::draw(GLuint instanceAttrib, GLenum indexType) {
+    // cull() leaves the commands alone without objects, so they still hold
+    // the last non-empty set's instance counts
+    if (!m_program || !m_objectCount) {
+        return;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glEnableVertexAttribArray(instanceAttrib);
+    glVertexAttribDivisor(instanceAttrib, 1);
+
+    // GLES 3.1 has no base instance, so each batch re-points the
+    // instance attribute at its slice of the compacted buffer
+    for (GLuint b = 0; b < m_batchCount; b++) {
+        glVertexAttribPointer(instanceAttrib, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+                              (const void *) (uintptr_t) (m_batchFirstInstance[b] * 4 * sizeof(GLfloat)));
+        glDrawElementsIndirect(GL_TRIANGLES, indexType,
+                               (const void *) (uintptr_t) (sizeof(CullHeader) + b * sizeof(CullCommand)));
+    }
+
+    glVertexAttribDivisor(instanceAttrib, 0);
+    glDisableVertexAttribArray(instanceAttrib);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// The threshold step the shader settled on, CULL_LOD_STEPS when it forced
+// the coarsest level.
+GLuint GpuCuller::budgetStep(const CullHeader &header) const {
+    if (!m_budget) {
+        return 0;
+    }
+    for (GLuint k = 0; k < CULL_LOD_STEPS; k++) {
+        if (header.stepTriangles[k] <= m_budget) {
+            return k;
+        }
+    }
+    return CULL_LOD_STEPS;
+}
+
+bool GpuCuller::readStats(CullStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!m_program || !m_objectCount) {
+        return false;
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    const unsigned char *data = (const unsigned char *) glMapBufferRange(
+            GL_SHADER_STORAGE_BUFFER, 0, sizeof(CullHeader) + m_batchCount * sizeof(CullCommand), GL_MAP_READ_BIT);
+    if (!data) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return false;
+    }
+
+    const CullHeader *header = (const CullHeader *) data;
+    const CullCommand *commands = (const CullCommand *) (data + sizeof(CullHeader));
+    for (GLuint b = 0; b < m_batchCount; b++) {
+        GLuint use = commands[b].draw.instanceCount;
+        stats->visible += use;
+        stats->triangles += use * (commands[b].draw.count / 3);
+        if (b < CULL_MAX_LEVELS) {
+            stats->batchUse[b] = use;
+        }
+    }
+    if (m_levelCount) {
+        GLuint step = budgetStep(*header);
+        stats->threshold = step < CULL_LOD_STEPS ? m_threshold * exp2f(0.25f * step) : FLT_MAX;
+    }
+
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+}
@@ -0,0 +1,181 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <GLES3/gl31.h>
+
+#define CULL_MAX_LEVELS 8
+#define CULL_LOD_STEPS 64
+#define CULL_SCALE_BINS 64
+#define CULL_LEVEL_NONE 0xff
+
+// Bounding sphere of one object, laid out to match the std430 struct
+// read by the culling compute shader (32 bytes per object).
+struct CullObject {
+    GLfloat center[3];
+    GLfloat radius;
+    GLuint batch;          // index into the batch table
+    GLuint pad[3];
+};
+
+// One indirect draw: a range of the bound index buffer drawn instanced
+// once per surviving object of the batch.
+struct CullBatch {
+    GLuint indexCount;
+    GLuint firstIndex;
+};
+
+// Layout mandated by glDrawElementsIndirect. GLES 3.1 has no base vertex
+// draws, so baseVertex is always written as zero.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint reservedMustBeZero;
+};
+
+// One batch as the culling shader sees it: the indirect command, then the
+// start of the batch's slice of the compacted instance buffer.
+struct CullCommand {
+    DrawElementsIndirectCommand draw;
+    GLuint firstInstance;
+};
+
+// Start of the command buffer, ahead of the CullCommand array: what the
+// shader reads and adds up for level of detail selection. stepTriangles[k]
+// is the triangle total at threshold step k, the last entry the total with
+// every visible object at the coarsest level. scaleCount counts visible
+// objects per half octave of pixel scale and admitted those let in from
+// the bin that crosses the budget, for when even the coarsest level does
+// not fit.
+struct CullHeader {
+    GLuint stepTriangles[CULL_LOD_STEPS + 1];
+    GLuint scaleCount[CULL_SCALE_BINS];
+    GLuint admitted;
+    GLfloat levelError[CULL_MAX_LEVELS];
+    GLuint levelTriangles[CULL_MAX_LEVELS];
+};
+
+// What the last GpuCuller::cull() produced, see readStats().
+struct CullStats {
+    GLuint visible;
+    GLuint triangles;
+    // effective LOD threshold in pixels, FLT_MAX when the budget forced
+    // every object to the coarsest level, 0 without LOD selection
+    GLfloat threshold;
+    GLuint batchUse[CULL_MAX_LEVELS];
+};
+
+// Extracts the six clip planes (left, right, bottom, top, near, far) from
+// a column-major view-projection matrix as normalized (a, b, c, d) tuples.
+void extractFrustumPlanes(const GLfloat viewProj[16], GLfloat planes[24]);
+
+bool sphereInFrustum(const GLfloat planes[24], const GLfloat center[3], GLfloat radius);
+
+
+// Frustum (and optionally Hi-Z occlusion) culling on the GPU.
+// A compute shader tests every object, appends the survivors of each batch
+// to a compacted instance buffer and bumps the instance count of that
+// batch's indirect command, so drawing costs one call per batch no matter
+// how many objects are visible. With setLod() the shader also picks each
+// object's batch as its level of detail, so the objects stay resident and
+// the CPU does no per-object work at all.
+class GpuCuller {
+
+public:
+    GpuCuller();
+    virtual ~GpuCuller();
+
+    // Requires a current GLES 3.1 context. Objects are copied to the GPU.
+    bool initialize(const CullObject* objects, GLuint objectCount,
+                    const CullBatch* batches, GLuint batchCount);
+    // Replaces the object set; objects naming an unknown batch are skipped.
+    // A different object count also forgets the LOD history.
+    void setObjects(const CullObject* objects, GLuint objectCount);
+    void destroy();
+
+    // Switches to level of detail selection: batch b becomes detail level b
+    // (finest first, at most CULL_MAX_LEVELS) whose error for an object of
+    // radius 1 is errors[b], and objects[i].batch is ignored. Levels follow
+    // the rules of LodSelector (lod.h), hysteresis and triangle budget (0
+    // for none) included, except that the threshold is raised for the
+    // budget in steps of 2^(1/4) rather than searched for, and objects
+    // dropped for the budget are ranked by half octaves of pixel scale.
+    bool setLod(const GLfloat* errors, GLfloat threshold, GLfloat hysteresis, GLuint budget);
+
+    // Depth pyramid of the previous frame (R32F, max depth per texel in
+    // window space [0,1]). Pass texture 0 to disable occlusion culling.
+    void setHiZ(GLuint texture, GLint levels, GLint width, GLint height);
+
+    // pixelScale is only used for LOD selection, see lodPixelScale().
+    void cull(const GLfloat viewProj[16], GLfloat pixelScale = 0.0f);
+
+    // Issues one glDrawElementsIndirect per batch. The caller binds the VAO
+    // holding the mesh vertex and index buffers; the compacted instance
+    // data (vec4 center, radius) is sourced from instanceAttrib.
+    void draw(GLuint instanceAttrib, GLenum indexType);
+
+    // Reads back what the last cull() produced. Waits for the GPU, so it
+    // is meant for periodic logging only.
+    bool readStats(CullStats* stats);
+
+private:
+    GLuint m_program;
+    GLuint m_objectBuffer;
+    GLuint m_commandBuffer;
+    GLuint m_instanceBuffer;
+    GLuint m_lodBuffer;
+    GLint m_uPlanes;
+    GLint m_uViewProj;
+    GLint m_uObjectCount;
+    GLint m_uBatchCount;
+    GLint m_uUseHiZ;
+    GLint m_uHiZ;
+    GLint m_uHiZSize;
+    GLint m_uHiZLevels;
+    GLint m_uPass;
+    GLint m_uLevelCount;
+    GLint m_uThreshold;
+    GLint m_uHysteresis;
+    GLint m_uPixelScale;
+    GLint m_uBudget;
+
+    GLuint m_objectCount;
+    GLuint m_instanceCapacity;
+    GLuint m_batchCount;
+    GLuint* m_batchFirstInstance;
+    CullHeader m_header;
+    CullCommand* m_commands;
+
+    GLuint m_levelCount;
+    GLfloat m_threshold;
+    GLfloat m_hysteresis;
+    GLuint m_budget;
+
+    GLuint m_hiZ;
+    GLint m_hiZLevels;
+    GLint m_hiZWidth;
+    GLint m_hiZHeight;
+
+    void layoutBatches(const CullObject* objects, GLuint objectCount);
+    void resetLod();
+    GLuint budgetStep(const CullHeader& header) const;
+};
+
+#endif // CULLING_H
@@ -0,0 +1,154 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef GLCALLS_H
+#define GLCALLS_H
+
+#include <stdint.h>
+
+// Capture stream shared by the on-device recorder (glcapture.cpp) and the
+// host replayer (tools/glreplay).
+//
+// File:   u32 magic, u32 version, then records until EOF.
+// Record: u16 call id, u16 argument count, u32 blob size,
+//         u64 arguments[count], blob bytes.
+// Integers are widened to u64 (signed values sign extended), floats are
+// stored as their bit pattern, pointers as addresses. Calls returning a
+// value carry it as the last argument. The blob holds memory the call
+// references (buffer contents, uniform arrays, strings, generated names).
+
+#define GLCAP_MAGIC 0x50434c47 // "GLCP"
+#define GLCAP_VERSION 1
+
+enum GlCallKind {
+    GLC_DRAW,       // draws, clears, blits, dispatches
+    GLC_STATE,      // binding and fixed state, checked for redundancy
+    GLC_UNIFORM,    // per-program state, checked for redundancy
+    GLC_OBJECT,     // object creation, deletion and uploads
+    GLC_QUERY,      // reads back from the driver
+    GLC_SYNC,       // flushes and barriers
+    GLC_META        // recorder records and EGL
+};
+
+// GLCALL(name, kind, group, keyArgs)
+// Redundancy is tracked per group over the first keyArgs arguments, so
+// glEnable/glDisable share the state of one capability. The replayer adds
+// the state selectors to the key: the active texture unit for
+// glBindTexture, the bound framebuffer for glReadBuffer/glDrawBuffers,
+// the bound VAO for vertex array state and GL_ELEMENT_ARRAY_BUFFER, and
+// splits GL_FRAMEBUFFER into its read and draw bindings.
+#define GL_CAPTURE_CALLS(GLCALL) \
+    GLCALL(glActiveTexture, GLC_STATE, glActiveTexture, 0) \
+    GLCALL(glAttachShader, GLC_OBJECT, glAttachShader, 0) \
+    GLCALL(glBindAttribLocation, GLC_OBJECT, glBindAttribLocation, 0) \
+    GLCALL(glBindBuffer, GLC_STATE, glBindBuffer, 1) \
+    GLCALL(glBindBufferBase, GLC_STATE, glBindBufferBase, 2) \
+    GLCALL(glBindFramebuffer, GLC_STATE, glBindFramebuffer, 1) \
+    GLCALL(glBindRenderbuffer, GLC_STATE, glBindRenderbuffer, 1) \
+    GLCALL(glBindTexture, GLC_STATE, glBindTexture, 1) \
+    GLCALL(glBindVertexArray, GLC_STATE, glBindVertexArray, 0) \
+    GLCALL(glBlitFramebuffer, GLC_DRAW, glBlitFramebuffer, 0) \
+    GLCALL(glBufferData, GLC_OBJECT, glBufferData, 0) \
+    GLCALL(glBufferSubData, GLC_OBJECT, glBufferSubData, 0) \
+    GLCALL(glCheckFramebufferStatus, GLC_QUERY, glCheckFramebufferStatus, 0) \
+    GLCALL(glClear, GLC_DRAW, glClear, 0) \
+    GLCALL(glClearColor, GLC_STATE, glClearColor, 0) \
+    GLCALL(glCompileShader, GLC_OBJECT, glCompileShader, 0) \
+    GLCALL(glCreateProgram, GLC_OBJECT, glCreateProgram, 0) \
+    GLCALL(glCreateShader, GLC_OBJECT, glCreateShader, 0) \
+    GLCALL(glDeleteBuffers, GLC_OBJECT, glDeleteBuffers, 0) \
+    GLCALL(glDeleteFramebuffers, GLC_OBJECT, glDeleteFramebuffers, 0) \
+    GLCALL(glDeleteProgram, GLC_OBJECT, glDeleteProgram, 0) \
+    GLCALL(glDeleteRenderbuffers, GLC_OBJECT, glDeleteRenderbuffers, 0) \
+    GLCALL(glDeleteShader, GLC_OBJECT, glDeleteShader, 0) \
+    GLCALL(glDeleteTextures, GLC_OBJECT, glDeleteTextures, 0) \
+    GLCALL(glDeleteVertexArrays, GLC_OBJECT, glDeleteVertexArrays, 0) \
+    GLCALL(glDetachShader, GLC_OBJECT, glDetachShader, 0) \
+    GLCALL(glDisable, GLC_STATE, glEnable, 1) \
+    GLCALL(glDisableVertexAttribArray, GLC_STATE, glEnableVertexAttribArray, 1) \
+    GLCALL(glDispatchCompute, GLC_DRAW, glDispatchCompute, 0) \
+    GLCALL(glDrawArrays, GLC_DRAW, glDrawArrays, 0) \
+    GLCALL(glDrawBuffers, GLC_STATE, glDrawBuffers, 0) \
+    GLCALL(glDrawElements, GLC_DRAW, glDrawElements, 0) \
+    GLCALL(glDrawElementsIndirect, GLC_DRAW, glDrawElementsIndirect, 0) \
+    GLCALL(glEnable, GLC_STATE, glEnable, 1) \
+    GLCALL(glEnableVertexAttribArray, GLC_STATE, glEnableVertexAttribArray, 1) \
+    GLCALL(glFlush, GLC_SYNC, glFlush, 0) \
+    GLCALL(glFramebufferRenderbuffer, GLC_OBJECT, glFramebufferRenderbuffer, 0) \
+    GLCALL(glFramebufferTexture2D, GLC_OBJECT, glFramebufferTexture2D, 0) \
+    GLCALL(glGenBuffers, GLC_OBJECT, glGenBuffers, 0) \
+    GLCALL(glGenFramebuffers, GLC_OBJECT, glGenFramebuffers, 0) \
+    GLCALL(glGenRenderbuffers, GLC_OBJECT, glGenRenderbuffers, 0) \
+    GLCALL(glGenTextures, GLC_OBJECT, glGenTextures, 0) \
+    GLCALL(glGenVertexArrays, GLC_OBJECT, glGenVertexArrays, 0) \
+    GLCALL(glGetAttribLocation, GLC_QUERY, glGetAttribLocation, 0) \
+    GLCALL(glGetError, GLC_QUERY, glGetError, 0) \
+    GLCALL(glGetIntegerv, GLC_QUERY, glGetIntegerv, 0) \
+    GLCALL(glGetProgramInfoLog, GLC_QUERY, glGetProgramInfoLog, 0) \
+    GLCALL(glGetProgramiv, GLC_QUERY, glGetProgramiv, 0) \
+    GLCALL(glGetShaderInfoLog, GLC_QUERY, glGetShaderInfoLog, 0) \
+    GLCALL(glGetShaderiv, GLC_QUERY, glGetShaderiv, 0) \
+    GLCALL(glGetString, GLC_QUERY, glGetString, 0) \
+    GLCALL(glGetUniformLocation, GLC_QUERY, glGetUniformLocation, 0) \
+    GLCALL(glInvalidateFramebuffer, GLC_DRAW, glInvalidateFramebuffer, 0) \
+    GLCALL(glLinkProgram, GLC_OBJECT, glLinkProgram, 0) \
+    GLCALL(glMapBufferRange, GLC_OBJECT, glMapBufferRange, 0) \
+    GLCALL(glMemoryBarrier, GLC_SYNC, glMemoryBarrier, 0) \
+    GLCALL(glReadBuffer, GLC_STATE, glReadBuffer, 0) \
+    GLCALL(glReadPixels, GLC_QUERY, glReadPixels, 0) \
+    GLCALL(glRenderbufferStorage, GLC_OBJECT, glRenderbufferStorage, 0) \
+    GLCALL(glRenderbufferStorageMultisample, GLC_OBJECT, glRenderbufferStorageMultisample, 0) \
+    GLCALL(glScissor, GLC_STATE, glScissor, 0) \
+    GLCALL(glShaderSource, GLC_OBJECT, glShaderSource, 0) \
+    GLCALL(glTexParameteri, GLC_OBJECT, glTexParameteri, 0) \
+    GLCALL(glTexStorage2D, GLC_OBJECT, glTexStorage2D, 0) \
+    GLCALL(glUniform1f, GLC_UNIFORM, glUniform1f, 1) \
+    GLCALL(glUniform1i, GLC_UNIFORM, glUniform1i, 1) \
+    GLCALL(glUniform1ui, GLC_UNIFORM, glUniform1ui, 1) \
+    GLCALL(glUniform2f, GLC_UNIFORM, glUniform2f, 1) \
+    GLCALL(glUniform4fv, GLC_UNIFORM, glUniform4fv, 1) \
+    GLCALL(glUniformMatrix4fv, GLC_UNIFORM, glUniformMatrix4fv, 1) \
+    GLCALL(glUnmapBuffer, GLC_OBJECT, glUnmapBuffer, 0) \
+    GLCALL(glUseProgram, GLC_STATE, glUseProgram, 0) \
+    GLCALL(glVertexAttrib4f, GLC_STATE, glVertexAttrib4f, 1) \
+    GLCALL(glVertexAttribDivisor, GLC_STATE, glVertexAttribDivisor, 1) \
+    GLCALL(glVertexAttribPointer, GLC_STATE, glVertexAttribPointer, 1) \
+    GLCALL(glViewport, GLC_STATE, glViewport, 0) \
+    GLCALL(ClientArray, GLC_META, ClientArray, 0) \
+    GLCALL(eglQuerySurface, GLC_META, eglQuerySurface, 0) \
+    GLCALL(eglSwapBuffers, GLC_META, eglSwapBuffers, 0)
+
+enum GlCallId {
+#define GLCALL_ENUM(name, kind, group, keyArgs) GLC_##name,
+    GL_CAPTURE_CALLS(GLCALL_ENUM)
+#undef GLCALL_ENUM
+    GLC_COUNT
+};
+
+struct GlCallInfo {
+    const char* name;
+    GlCallKind kind;
+    GlCallId group;
+    int keyArgs;
+};
+
+static const GlCallInfo glCallInfo[GLC_COUNT] = {
+#define GLCALL_INFO(name, kind, group, keyArgs) { #name, kind, GLC_##group, keyArgs },
+    GL_CAPTURE_CALLS(GLCALL_INFO)
+#undef GLCALL_INFO
+};
+
+#endif // GLCALLS_H
@@ -0,0 +1,566 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifdef GL_CAPTURE
+
+#define GLCAPTURE_IMPL
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+#include "glcapture.h"
+
+#define LOG_TAG "EglSample"
+
+#define GLCAP_CHUNK_SIZE (256 * 1024)
+#define GLCAP_MAX_CHUNKS 8
+#define GLCAP_MAX_ATTRIBS 16
+#define GLCAP_MAX_MAPPINGS 8
+
+struct Chunk {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+bool GlCapture::s_active = false;
+
+// Render thread fills s_current; full chunks are queued for the writer
+// thread, which owns the file. The render thread only blocks when the
+// writer falls GLCAP_MAX_CHUNKS behind.
+static Chunk s_current;
+static Chunk s_queue[GLCAP_MAX_CHUNKS];
+static int s_queueHead = 0;
+static int s_queueCount = 0;
+static bool s_stop = false;
+static pthread_t s_writer;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_notEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_notFull = PTHREAD_COND_INITIALIZER;
+static FILE* s_file = 0;
+static int s_frames = 0;
+static int s_maxFrames = 0;
+static int s_sequence = 0;
+
+// client-side vertex arrays of the default VAO, sent with each draw
+struct ClientArray {
+    const void* pointer;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLsizei stride;
+    bool client;
+    bool enabled;
+};
+
+static ClientArray s_arrays[GLCAP_MAX_ATTRIBS];
+static GLuint s_vertexArray = 0;
+
+// writable mappings by target, so glUnmapBuffer can record what was
+// stored through them
+struct Mapping {
+    GLenum target;
+    void* pointer;
+    GLsizeiptr length;
+};
+
+static Mapping s_mappings[GLCAP_MAX_MAPPINGS];
+
+static void* writerThread(void*) {
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        while (s_queueCount == 0 && !s_stop) {
+            pthread_cond_wait(&s_notEmpty, &s_mutex);
+        }
+        if (s_queueCount == 0) {
+            pthread_mutex_unlock(&s_mutex);
+            break;
+        }
+        Chunk chunk = s_queue[s_queueHead];
+        s_queueHead = (s_queueHead + 1) % GLCAP_MAX_CHUNKS;
+        s_queueCount--;
+        pthread_cond_signal(&s_notFull);
+        pthread_mutex_unlock(&s_mutex);
+
+        if (fwrite(chunk.data, 1, chunk.size, s_file) != chunk.size) {
+            LOG_ERROR("GlCapture: write failed");
+        }
+        free(chunk.data);
+    }
+    return 0;
+}
+
+static void submit() {
+    if (s_current.size == 0) {
+        return;
+    }
+    pthread_mutex_lock(&s_mutex);
+    while (s_queueCount == GLCAP_MAX_CHUNKS) {
+        pthread_cond_wait(&s_notFull, &s_mutex);
+    }
+    s_queue[(s_queueHead + s_queueCount) % GLCAP_MAX_CHUNKS] = s_current;
+    s_queueCount++;
+    pthread_cond_signal(&s_notEmpty);
+    pthread_mutex_unlock(&s_mutex);
+
+    s_current.data = 0;
+    s_current.size = 0;
+    s_current.capacity = 0;
+}
+
+bool GlCapture::begin(const char* path, int maxFrames) {
+    if (s_active) {
+        return true;
+    }
+
+    char dir[256];
+    strncpy(dir, path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = 0;
+    char* slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = 0;
+        mkdir(dir, 0700);
+    }
+
+    // every render loop gets its own file, so a surface recreation does
+    // not truncate the capture of the previous one: capture.glcap,
+    // capture-1.glcap, capture-2.glcap, ...
+    char name[256];
+    strncpy(name, path, sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+    if (s_sequence > 0) {
+        const char* base = strrchr(path, '/');
+        const char* ext = strrchr(base ? base : path, '.');
+        int stem = ext ? (int) (ext - path) : (int) strlen(path);
+        snprintf(name, sizeof(name), "%.*s-%d%s", stem, path, s_sequence, ext ? ext : "");
+    }
+
+    s_file = fopen(name, "wb");
+    if (!s_file) {
+        LOG_ERROR("GlCapture: cannot open %s", name);
+        return false;
+    }
+    s_sequence++;
+    uint32_t header[2] = { GLCAP_MAGIC, GLCAP_VERSION };
+    fwrite(header, sizeof(header), 1, s_file);
+
+    s_stop = false;
+    s_frames = 0;
+    s_maxFrames = maxFrames;
+    pthread_create(&s_writer, 0, writerThread, 0);
+    s_active = true;
+    LOG_INFO("GlCapture: recording %d frames to %s", maxFrames, name);
+    return true;
+}
+
+void GlCapture::end() {
+    if (!s_active) {
+        return;
+    }
+    s_active = false;
+    submit();
+
+    pthread_mutex_lock(&s_mutex);
+    s_stop = true;
+    pthread_cond_signal(&s_notEmpty);
+    pthread_mutex_unlock(&s_mutex);
+    pthread_join(s_writer, 0);
+
+    fclose(s_file);
+    s_file = 0;
+    LOG_INFO("GlCapture: finished after %d frames", s_frames);
+}
+
+void GlCapture::record(GlCallId id, const uint64_t* args, int argCount,
+                       const void* blob, uint32_t blobSize) {
+    size_t size = 8 + argCount * sizeof(uint64_t) + blobSize;
+    if (s_current.size + size > s_current.capacity) {
+        submit();
+        s_current.capacity = size > GLCAP_CHUNK_SIZE ? size : GLCAP_CHUNK_SIZE;
+        s_current.data = (uint8_t*) malloc(s_current.capacity);
+    }
+
+    uint8_t* p = s_current.data + s_current.size;
+    uint16_t head[2] = { (uint16_t) id, (uint16_t) argCount };
+    memcpy(p, head, sizeof(head));
+    memcpy(p + 4, &blobSize, sizeof(blobSize));
+    memcpy(p + 8, args, argCount * sizeof(uint64_t));
+    if (blobSize) {
+        memcpy(p + 8 + argCount * sizeof(uint64_t), blob, blobSize);
+    }
+    s_current.size += size;
+}
+
+void GlCapture::frameEnd() {
+    submit();
+    if (++s_frames >= s_maxFrames) {
+        end();
+    }
+}
+
+static void recordNames(GlCallId id, GLsizei n, const GLuint* names) {
+    uint64_t a[] = { glcapArg(n) };
+    GlCapture::record(id, a, 1, names, n * sizeof(GLuint));
+}
+
+void glcap_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    glBufferData(target, size, data, usage);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(target), glcapArg(size), glcapArg(data), glcapArg(usage) };
+        GlCapture::record(GLC_glBufferData, a, 4, data, data ? size : 0);
+    }
+}
+
+void glcap_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    glBufferSubData(target, offset, size, data);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(target), glcapArg(offset), glcapArg(size) };
+        GlCapture::record(GLC_glBufferSubData, a, 3, data, size);
+    }
+}
+
+void glcap_glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) {
+    glShaderSource(shader, count, string, length);
+    if (GlCapture::active()) {
+        // replayed as one NUL terminated string
+        size_t total = 1;
+        for (GLsizei i = 0; i < count; i++) {
+            total += (length && length[i] >= 0) ? length[i] : strlen(string[i]);
+        }
+        char* src = (char*) malloc(total);
+        size_t pos = 0;
+        for (GLsizei i = 0; i < count; i++) {
+            size_t n = (length && length[i] >= 0) ? length[i] : strlen(string[i]);
+            memcpy(src + pos, string[i], n);
+            pos += n;
+        }
+        src[pos] = 0;
+        uint64_t a[] = { glcapArg(shader) };
+        GlCapture::record(GLC_glShaderSource, a, 1, src, total);
+        free(src);
+    }
+}
+
+void glcap_glUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    glUniform4fv(location, count, value);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(location), glcapArg(count) };
+        GlCapture::record(GLC_glUniform4fv, a, 2, value, count * 4 * sizeof(GLfloat));
+    }
+}
+
+void glcap_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    glUniformMatrix4fv(location, count, transpose, value);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(location), glcapArg(count), glcapArg(transpose) };
+        GlCapture::record(GLC_glUniformMatrix4fv, a, 3, value, count * 16 * sizeof(GLfloat));
+    }
+}
+
+void glcap_glDrawBuffers(GLsizei n, const GLenum* bufs) {
+    glDrawBuffers(n, bufs);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(n) };
+        GlCapture::record(GLC_glDrawBuffers, a, 1, bufs, n * sizeof(GLenum));
+    }
+}
+
+void glcap_glInvalidateFramebuffer(GLenum target, GLsizei numAttachments, const GLenum* attachments) {
+    glInvalidateFramebuffer(target, numAttachments, attachments);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(target), glcapArg(numAttachments) };
+        GlCapture::record(GLC_glInvalidateFramebuffer, a, 2, attachments, numAttachments * sizeof(GLenum));
+    }
+}
+
+#define GLCAP_NAMES_WRAPPER(fn, constness) \
+    void glcap_##fn(GLsizei n, constness GLuint* names) { \
+        fn(n, names); \
+        if (GlCapture::active()) { \
+            recordNames(GLC_##fn, n, names); \
+        } \
+    }
+
+GLCAP_NAMES_WRAPPER(glGenBuffers, )
+GLCAP_NAMES_WRAPPER(glGenFramebuffers, )
+GLCAP_NAMES_WRAPPER(glGenRenderbuffers, )
+GLCAP_NAMES_WRAPPER(glGenTextures, )
+GLCAP_NAMES_WRAPPER(glGenVertexArrays, )
+GLCAP_NAMES_WRAPPER(glDeleteBuffers, const)
+GLCAP_NAMES_WRAPPER(glDeleteFramebuffers, const)
+GLCAP_NAMES_WRAPPER(glDeleteRenderbuffers, const)
+GLCAP_NAMES_WRAPPER(glDeleteTextures, const)
+GLCAP_NAMES_WRAPPER(glDeleteVertexArrays, const)
+
+GLint glcap_glGetUniformLocation(GLuint program, const GLchar* name) {
+    GLint location = glGetUniformLocation(program, name);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(program), glcapArg(location) };
+        GlCapture::record(GLC_glGetUniformLocation, a, 2, name, strlen(name) + 1);
+    }
+    return location;
+}
+
+GLint glcap_glGetAttribLocation(GLuint program, const GLchar* name) {
+    GLint location = glGetAttribLocation(program, name);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(program), glcapArg(location) };
+        GlCapture::record(GLC_glGetAttribLocation, a, 2, name, strlen(name) + 1);
+    }
+    return location;
+}
+
+void glcap_glBindAttribLocation(GLuint program, GLuint index, const GLchar* name) {
+    glBindAttribLocation(program, index, name);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(program), glcapArg(index) };
+        GlCapture::record(GLC_glBindAttribLocation, a, 2, name, strlen(name) + 1);
+    }
+}
+
+void glcap_glBindVertexArray(GLuint array) {
+    glBindVertexArray(array);
+    s_vertexArray = array;
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(array) };
+        GlCapture::record(GLC_glBindVertexArray, a, 1);
+    }
+}
+
+void glcap_glEnableVertexAttribArray(GLuint index) {
+    glEnableVertexAttribArray(index);
+    if (s_vertexArray == 0 && index < GLCAP_MAX_ATTRIBS) {
+        s_arrays[index].enabled = true;
+    }
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(index) };
+        GlCapture::record(GLC_glEnableVertexAttribArray, a, 1);
+    }
+}
+
+void glcap_glDisableVertexAttribArray(GLuint index) {
+    glDisableVertexAttribArray(index);
+    if (s_vertexArray == 0 && index < GLCAP_MAX_ATTRIBS) {
+        s_arrays[index].enabled = false;
+    }
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(index) };
+        GlCapture::record(GLC_glDisableVertexAttribArray, a, 1);
+    }
+}
+
+void glcap_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                 GLsizei stride, const void* pointer) {
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    if (!GlCapture::active()) {
+        return;
+    }
+    if (s_vertexArray == 0 && index < GLCAP_MAX_ATTRIBS) {
+        GLint buffer = 0;
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &buffer);
+        ClientArray &c = s_arrays[index];
+        c.pointer = pointer;
+        c.size = size;
+        c.type = type;
+        c.normalized = normalized;
+        c.stride = stride;
+        c.client = buffer == 0;
+    }
+    uint64_t a[] = { glcapArg(index), glcapArg(size), glcapArg(type), glcapArg(normalized),
+                     glcapArg(stride), glcapArg(pointer) };
+    GlCapture::record(GLC_glVertexAttribPointer, a, 6);
+}
+
+static GLsizei typeSize(GLenum type) {
+    switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+// Client memory is only read at draw time, so the enabled client arrays
+// are shipped with each draw, covering vertices [0, vertexCount).
+static void recordClientArrays(GLuint vertexCount) {
+    if (s_vertexArray != 0 || vertexCount == 0) {
+        return;
+    }
+    for (GLuint i = 0; i < GLCAP_MAX_ATTRIBS; i++) {
+        const ClientArray &c = s_arrays[i];
+        if (!c.enabled || !c.client) {
+            continue;
+        }
+        GLsizei element = c.size * typeSize(c.type);
+        GLsizei stride = c.stride ? c.stride : element;
+        uint32_t bytes = (vertexCount - 1) * stride + element;
+        uint64_t a[] = { glcapArg(i), glcapArg(c.size), glcapArg(c.type),
+                         glcapArg(c.normalized), glcapArg(c.stride) };
+        GlCapture::record(GLC_ClientArray, a, 5, c.pointer, bytes);
+    }
+}
+
+static bool clientArraysEnabled() {
+    if (s_vertexArray != 0) {
+        return false;
+    }
+    for (GLuint i = 0; i < GLCAP_MAX_ATTRIBS; i++) {
+        if (s_arrays[i].enabled && s_arrays[i].client) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static GLuint indexSize(GLenum type) {
+    return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+static GLuint maxIndex(GLenum type, const void* indices, GLsizei count) {
+    GLuint max = 0;
+    for (GLsizei i = 0; i < count; i++) {
+        GLuint index;
+        if (type == GL_UNSIGNED_BYTE) {
+            index = ((const GLubyte*) indices)[i];
+        } else if (type == GL_UNSIGNED_SHORT) {
+            index = ((const GLushort*) indices)[i];
+        } else {
+            index = ((const GLuint*) indices)[i];
+        }
+        if (index > max) {
+            max = index;
+        }
+    }
+    return max;
+}
+
+void glcap_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    if (GlCapture::active() && count > 0) {
+        recordClientArrays(first + count);
+    }
+    glDrawArrays(mode, first, count);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(mode), glcapArg(first), glcapArg(count) };
+        GlCapture::record(GLC_glDrawArrays, a, 3);
+    }
+}
+
+void glcap_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    if (!GlCapture::active() || count <= 0) {
+        glDrawElements(mode, count, type, indices);
+        return;
+    }
+
+    GLint elementBuffer = 0;
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+    const void* clientIndices = elementBuffer == 0 ? indices : 0;
+    if (clientArraysEnabled()) {
+        // the replayer needs every vertex the indices reach
+        GLuint max = 0;
+        if (clientIndices) {
+            max = maxIndex(type, clientIndices, count);
+        } else {
+            const void* mapped = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, (GLintptr) indices,
+                                                  count * indexSize(type), GL_MAP_READ_BIT);
+            if (mapped) {
+                max = maxIndex(type, mapped, count);
+                glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+            } else {
+                LOG_ERROR("GlCapture: cannot read indices of a client array draw");
+            }
+        }
+        recordClientArrays(max + 1);
+    }
+
+    glDrawElements(mode, count, type, indices);
+    // client indices travel in the blob, buffer offsets as the pointer
+    uint64_t a[] = { glcapArg(mode), glcapArg(count), glcapArg(type), glcapArg(indices) };
+    GlCapture::record(GLC_glDrawElements, a, 4, clientIndices,
+                      clientIndices ? count * indexSize(type) : 0);
+}
+
+void* glcap_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    void* pointer = glMapBufferRange(target, offset, length, access);
+    if (pointer && (access & GL_MAP_WRITE_BIT)) {
+        for (int i = 0; i < GLCAP_MAX_MAPPINGS; i++) {
+            if (!s_mappings[i].pointer) {
+                s_mappings[i].target = target;
+                s_mappings[i].pointer = pointer;
+                s_mappings[i].length = length;
+                break;
+            }
+        }
+    }
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(target), glcapArg(offset), glcapArg(length), glcapArg(access) };
+        GlCapture::record(GLC_glMapBufferRange, a, 4);
+    }
+    return pointer;
+}
+
+GLboolean glcap_glUnmapBuffer(GLenum target) {
+    Mapping* mapping = 0;
+    for (int i = 0; i < GLCAP_MAX_MAPPINGS; i++) {
+        if (s_mappings[i].pointer && s_mappings[i].target == target) {
+            mapping = &s_mappings[i];
+            break;
+        }
+    }
+    if (GlCapture::active()) {
+        // the written range travels in the blob, taken before the unmap
+        // invalidates the pointer
+        uint64_t a[] = { glcapArg(target) };
+        GlCapture::record(GLC_glUnmapBuffer, a, 1, mapping ? mapping->pointer : 0,
+                          mapping ? mapping->length : 0);
+    }
+    if (mapping) {
+        mapping->pointer = 0;
+    }
+    return glUnmapBuffer(target);
+}
+
+EGLBoolean glcap_eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+    if (GlCapture::active()) {
+        uint64_t a[] = { 0 };
+        GlCapture::record(GLC_eglSwapBuffers, a, 0);
+    }
+    EGLBoolean result = eglSwapBuffers(display, surface);
+    if (GlCapture::active()) {
+        GlCapture::frameEnd();
+    }
+    return result;
+}
+
+EGLBoolean glcap_eglQuerySurface(EGLDisplay display, EGLSurface surface, EGLint attribute, EGLint* value) {
+    EGLBoolean result = eglQuerySurface(display, surface, attribute, value);
+    if (GlCapture::active() && result) {
+        uint64_t a[] = { glcapArg(attribute), glcapArg(*value) };
+        GlCapture::record(GLC_eglQuerySurface, a, 2);
+    }
+    return result;
+}
+
+#endif // GL_CAPTURE
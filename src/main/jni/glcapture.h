@@ -0,0 +1,216 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef GLCAPTURE_H
+#define GLCAPTURE_H
+
+// Opt-in GL/EGL command capture. Build with -DGL_CAPTURE and include this
+// header last in every file that issues GL calls; the calls listed in
+// glcalls.h are then routed through recording wrappers. Records are
+// batched into chunks and written by a background thread, see
+// tools/glreplay for the host replayer.
+
+#ifdef GL_CAPTURE
+
+#include <stdint.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+
+#include "glcalls.h"
+
+#ifndef GL_CAPTURE_PATH
+#define GL_CAPTURE_PATH "/data/data/tsaarni.nativeeglexample/files/capture.glcap"
+#endif
+
+#ifndef GL_CAPTURE_FRAMES
+#define GL_CAPTURE_FRAMES 300
+#endif
+
+class GlCapture {
+
+public:
+    // Starts recording to path; stops by itself after maxFrames swaps.
+    // Later recordings in the same process go to path with a -1, -2, ...
+    // suffix before the extension.
+    static bool begin(const char* path, int maxFrames);
+    static void end();
+
+    static inline bool active() { return s_active; }
+
+    static void record(GlCallId id, const uint64_t* args, int argCount,
+                       const void* blob = 0, uint32_t blobSize = 0);
+    static void frameEnd();
+
+private:
+    static bool s_active;
+};
+
+template<typename T>
+inline uint64_t glcapArg(T v) { return (uint64_t) (int64_t) v; }
+template<typename T>
+inline uint64_t glcapArg(T* p) { return (uint64_t) (uintptr_t) p; }
+inline uint64_t glcapArg(GLfloat v) { uint32_t u; memcpy(&u, &v, sizeof(u)); return u; }
+
+// Converts a wrapper argument to the parameter type of the real call; a
+// literal 0 or NULL passed for a pointer becomes a null pointer.
+template<typename P, typename A>
+inline P glcapParam(A a) { return a; }
+template<typename P>
+inline P glcapParam(int a) { return (P) (intptr_t) a; }
+template<typename P>
+inline P glcapParam(long a) { return (P) (intptr_t) a; }
+
+// Generic wrappers for calls whose arguments are plain values.
+template<typename... P, typename... A>
+inline void glcapCall(GlCallId id, void (*fn)(P...), A... args) {
+    fn(glcapParam<P>(args)...);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(glcapParam<P>(args))..., 0 };
+        GlCapture::record(id, a, sizeof...(P));
+    }
+}
+
+template<typename R, typename... P, typename... A>
+inline R glcapCall(GlCallId id, R (*fn)(P...), A... args) {
+    R r = fn(glcapParam<P>(args)...);
+    if (GlCapture::active()) {
+        uint64_t a[] = { glcapArg(glcapParam<P>(args))..., glcapArg(r) };
+        GlCapture::record(id, a, sizeof...(P) + 1);
+    }
+    return r;
+}
+
+// Calls that reference client memory or client-side vertex arrays.
+void glcap_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+void glcap_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+void glcap_glShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
+void glcap_glUniform4fv(GLint location, GLsizei count, const GLfloat* value);
+void glcap_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+void glcap_glDrawBuffers(GLsizei n, const GLenum* bufs);
+void glcap_glInvalidateFramebuffer(GLenum target, GLsizei numAttachments, const GLenum* attachments);
+void glcap_glGenBuffers(GLsizei n, GLuint* names);
+void glcap_glGenFramebuffers(GLsizei n, GLuint* names);
+void glcap_glGenRenderbuffers(GLsizei n, GLuint* names);
+void glcap_glGenTextures(GLsizei n, GLuint* names);
+void glcap_glGenVertexArrays(GLsizei n, GLuint* names);
+void glcap_glDeleteBuffers(GLsizei n, const GLuint* names);
+void glcap_glDeleteFramebuffers(GLsizei n, const GLuint* names);
+void glcap_glDeleteRenderbuffers(GLsizei n, const GLuint* names);
+void glcap_glDeleteTextures(GLsizei n, const GLuint* names);
+void glcap_glDeleteVertexArrays(GLsizei n, const GLuint* names);
+GLint glcap_glGetUniformLocation(GLuint program, const GLchar* name);
+GLint glcap_glGetAttribLocation(GLuint program, const GLchar* name);
+void glcap_glBindAttribLocation(GLuint program, GLuint index, const GLchar* name);
+void glcap_glBindVertexArray(GLuint array);
+void glcap_glEnableVertexAttribArray(GLuint index);
+void glcap_glDisableVertexAttribArray(GLuint index);
+void glcap_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                 GLsizei stride, const void* pointer);
+void glcap_glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void glcap_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void* glcap_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+GLboolean glcap_glUnmapBuffer(GLenum target);
+EGLBoolean glcap_eglSwapBuffers(EGLDisplay display, EGLSurface surface);
+EGLBoolean glcap_eglQuerySurface(EGLDisplay display, EGLSurface surface, EGLint attribute, EGLint* value);
+
+#ifndef GLCAPTURE_IMPL
+
+#define glActiveTexture(...) glcapCall(GLC_glActiveTexture, ::glActiveTexture, __VA_ARGS__)
+#define glAttachShader(...) glcapCall(GLC_glAttachShader, ::glAttachShader, __VA_ARGS__)
+#define glBindBuffer(...) glcapCall(GLC_glBindBuffer, ::glBindBuffer, __VA_ARGS__)
+#define glBindBufferBase(...) glcapCall(GLC_glBindBufferBase, ::glBindBufferBase, __VA_ARGS__)
+#define glBindFramebuffer(...) glcapCall(GLC_glBindFramebuffer, ::glBindFramebuffer, __VA_ARGS__)
+#define glBindRenderbuffer(...) glcapCall(GLC_glBindRenderbuffer, ::glBindRenderbuffer, __VA_ARGS__)
+#define glBindTexture(...) glcapCall(GLC_glBindTexture, ::glBindTexture, __VA_ARGS__)
+#define glBlitFramebuffer(...) glcapCall(GLC_glBlitFramebuffer, ::glBlitFramebuffer, __VA_ARGS__)
+#define glCheckFramebufferStatus(...) glcapCall(GLC_glCheckFramebufferStatus, ::glCheckFramebufferStatus, __VA_ARGS__)
+#define glClear(...) glcapCall(GLC_glClear, ::glClear, __VA_ARGS__)
+#define glClearColor(...) glcapCall(GLC_glClearColor, ::glClearColor, __VA_ARGS__)
+#define glCompileShader(...) glcapCall(GLC_glCompileShader, ::glCompileShader, __VA_ARGS__)
+#define glCreateProgram() glcapCall(GLC_glCreateProgram, ::glCreateProgram)
+#define glCreateShader(...) glcapCall(GLC_glCreateShader, ::glCreateShader, __VA_ARGS__)
+#define glDeleteProgram(...) glcapCall(GLC_glDeleteProgram, ::glDeleteProgram, __VA_ARGS__)
+#define glDeleteShader(...) glcapCall(GLC_glDeleteShader, ::glDeleteShader, __VA_ARGS__)
+#define glDetachShader(...) glcapCall(GLC_glDetachShader, ::glDetachShader, __VA_ARGS__)
+#define glDisable(...) glcapCall(GLC_glDisable, ::glDisable, __VA_ARGS__)
+#define glDispatchCompute(...) glcapCall(GLC_glDispatchCompute, ::glDispatchCompute, __VA_ARGS__)
+#define glDrawElementsIndirect(...) glcapCall(GLC_glDrawElementsIndirect, ::glDrawElementsIndirect, __VA_ARGS__)
+#define glEnable(...) glcapCall(GLC_glEnable, ::glEnable, __VA_ARGS__)
+#define glFlush() glcapCall(GLC_glFlush, ::glFlush)
+#define glFramebufferRenderbuffer(...) glcapCall(GLC_glFramebufferRenderbuffer, ::glFramebufferRenderbuffer, __VA_ARGS__)
+#define glFramebufferTexture2D(...) glcapCall(GLC_glFramebufferTexture2D, ::glFramebufferTexture2D, __VA_ARGS__)
+#define glGetError() glcapCall(GLC_glGetError, ::glGetError)
+#define glGetIntegerv(...) glcapCall(GLC_glGetIntegerv, ::glGetIntegerv, __VA_ARGS__)
+#define glGetProgramInfoLog(...) glcapCall(GLC_glGetProgramInfoLog, ::glGetProgramInfoLog, __VA_ARGS__)
+#define glGetProgramiv(...) glcapCall(GLC_glGetProgramiv, ::glGetProgramiv, __VA_ARGS__)
+#define glGetShaderInfoLog(...) glcapCall(GLC_glGetShaderInfoLog, ::glGetShaderInfoLog, __VA_ARGS__)
+#define glGetShaderiv(...) glcapCall(GLC_glGetShaderiv, ::glGetShaderiv, __VA_ARGS__)
+#define glGetString(...) glcapCall(GLC_glGetString, ::glGetString, __VA_ARGS__)
+#define glLinkProgram(...) glcapCall(GLC_glLinkProgram, ::glLinkProgram, __VA_ARGS__)
+#define glMemoryBarrier(...) glcapCall(GLC_glMemoryBarrier, ::glMemoryBarrier, __VA_ARGS__)
+#define glReadBuffer(...) glcapCall(GLC_glReadBuffer, ::glReadBuffer, __VA_ARGS__)
+#define glReadPixels(...) glcapCall(GLC_glReadPixels, ::glReadPixels, __VA_ARGS__)
+#define glRenderbufferStorage(...) glcapCall(GLC_glRenderbufferStorage, ::glRenderbufferStorage, __VA_ARGS__)
+#define glRenderbufferStorageMultisample(...) glcapCall(GLC_glRenderbufferStorageMultisample, ::glRenderbufferStorageMultisample, __VA_ARGS__)
+#define glScissor(...) glcapCall(GLC_glScissor, ::glScissor, __VA_ARGS__)
+#define glTexParameteri(...) glcapCall(GLC_glTexParameteri, ::glTexParameteri, __VA_ARGS__)
+#define glTexStorage2D(...) glcapCall(GLC_glTexStorage2D, ::glTexStorage2D, __VA_ARGS__)
+#define glUniform1f(...) glcapCall(GLC_glUniform1f, ::glUniform1f, __VA_ARGS__)
+#define glUniform1i(...) glcapCall(GLC_glUniform1i, ::glUniform1i, __VA_ARGS__)
+#define glUniform1ui(...) glcapCall(GLC_glUniform1ui, ::glUniform1ui, __VA_ARGS__)
+#define glUniform2f(...) glcapCall(GLC_glUniform2f, ::glUniform2f, __VA_ARGS__)
+#define glUseProgram(...) glcapCall(GLC_glUseProgram, ::glUseProgram, __VA_ARGS__)
+#define glVertexAttrib4f(...) glcapCall(GLC_glVertexAttrib4f, ::glVertexAttrib4f, __VA_ARGS__)
+#define glVertexAttribDivisor(...) glcapCall(GLC_glVertexAttribDivisor, ::glVertexAttribDivisor, __VA_ARGS__)
+#define glViewport(...) glcapCall(GLC_glViewport, ::glViewport, __VA_ARGS__)
+
+#define glBufferData glcap_glBufferData
+#define glBufferSubData glcap_glBufferSubData
+#define glShaderSource glcap_glShaderSource
+#define glUniform4fv glcap_glUniform4fv
+#define glUniformMatrix4fv glcap_glUniformMatrix4fv
+#define glDrawBuffers glcap_glDrawBuffers
+#define glInvalidateFramebuffer glcap_glInvalidateFramebuffer
+#define glGenBuffers glcap_glGenBuffers
+#define glGenFramebuffers glcap_glGenFramebuffers
+#define glGenRenderbuffers glcap_glGenRenderbuffers
+#define glGenTextures glcap_glGenTextures
+#define glGenVertexArrays glcap_glGenVertexArrays
+#define glDeleteBuffers glcap_glDeleteBuffers
+#define glDeleteFramebuffers glcap_glDeleteFramebuffers
+#define glDeleteRenderbuffers glcap_glDeleteRenderbuffers
+#define glDeleteTextures glcap_glDeleteTextures
+#define glDeleteVertexArrays glcap_glDeleteVertexArrays
+#define glGetUniformLocation glcap_glGetUniformLocation
+#define glGetAttribLocation glcap_glGetAttribLocation
+#define glBindAttribLocation glcap_glBindAttribLocation
+#define glBindVertexArray glcap_glBindVertexArray
+#define glEnableVertexAttribArray glcap_glEnableVertexAttribArray
+#define glDisableVertexAttribArray glcap_glDisableVertexAttribArray
+#define glVertexAttribPointer glcap_glVertexAttribPointer
+#define glDrawArrays glcap_glDrawArrays
+#define glDrawElements glcap_glDrawElements
+#define glMapBufferRange glcap_glMapBufferRange
+#define glUnmapBuffer glcap_glUnmapBuffer
+#define eglSwapBuffers glcap_eglSwapBuffers
+#define eglQuerySurface glcap_eglQuerySurface
+
+#endif // GLCAPTURE_IMPL
+
+#endif // GL_CAPTURE
+
+#endif // GLCAPTURE_H
@@ -0,0 +1,138 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <stddef.h>
+#include <string.h>
+
+#include "logger.h"
+#include "ingest.h"
+
+#define LOG_TAG "EglSample"
+
+// the Java side hard-codes these offsets
+static_assert(offsetof(IngestSlot, params) == 16, "IngestSlot params offset");
+static_assert(offsetof(IngestSlot, instances) == 80, "IngestSlot instances offset");
+static_assert(sizeof(CullObject) == 32, "CullObject size");
+
+IngestBuffer::IngestBuffer()
+        : m_slots(0), m_published(0), m_dropped(0) {
+    pthread_mutex_init(&m_mutex, 0);
+    m_slots = new IngestSlot[INGEST_SLOTS];
+    memset(m_slots, 0, INGEST_SLOTS * sizeof(IngestSlot));
+    for (int i = 0; i < INGEST_SLOTS; i++) {
+        m_state[i] = SLOT_FREE;
+    }
+}
+
+IngestBuffer::~IngestBuffer() {
+    delete[] m_slots;
+    pthread_mutex_destroy(&m_mutex);
+}
+
+int IngestBuffer::acquire() {
+    int slot = -1;
+
+    pthread_mutex_lock(&m_mutex);
+    for (int i = 0; i < INGEST_SLOTS; i++) {
+        if (m_state[i] == SLOT_FREE) {
+            m_state[i] = SLOT_WRITING;
+            slot = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    return slot;
+}
+
+bool IngestBuffer::publish(void* address) {
+    int slot = -1;
+    for (int i = 0; i < INGEST_SLOTS; i++) {
+        if (address == &m_slots[i]) {
+            slot = i;
+        }
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    bool ok = slot >= 0 && m_state[slot] == SLOT_WRITING;
+    if (ok) {
+        for (int i = 0; i < INGEST_SLOTS; i++) {
+            if (m_state[i] == SLOT_READY) {
+                m_state[i] = SLOT_FREE;
+                m_dropped++;
+            }
+        }
+        m_state[slot] = SLOT_READY;
+        m_published++;
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    if (!ok) {
+        LOG_ERROR("IngestBuffer: publish of unknown or unacquired slot %p", address);
+    }
+    return ok;
+}
+
+const IngestSlot* IngestBuffer::consume() {
+    const IngestSlot* result = 0;
+
+    pthread_mutex_lock(&m_mutex);
+    int ready = -1;
+    for (int i = 0; i < INGEST_SLOTS; i++) {
+        if (m_state[i] == SLOT_READY) {
+            ready = i;
+        }
+    }
+    // the slot read last frame stays in use until something replaces it
+    if (ready >= 0) {
+        for (int i = 0; i < INGEST_SLOTS; i++) {
+            if (m_state[i] == SLOT_READING) {
+                m_state[i] = SLOT_FREE;
+            }
+        }
+        m_state[ready] = SLOT_READING;
+        result = &m_slots[ready];
+    }
+    unsigned int published = m_published;
+    unsigned int dropped = m_dropped;
+    pthread_mutex_unlock(&m_mutex);
+
+    if (result && (published % 300) == 1) {
+        LOG_INFO("IngestBuffer: %u batches published, %u dropped", published, dropped);
+    }
+    return result;
+}
+
+IngestBuffer::SlotState IngestBuffer::state(int slot) {
+    pthread_mutex_lock(&m_mutex);
+    SlotState state = m_state[slot];
+    pthread_mutex_unlock(&m_mutex);
+    return state;
+}
+
+unsigned int IngestBuffer::published() {
+    pthread_mutex_lock(&m_mutex);
+    unsigned int published = m_published;
+    pthread_mutex_unlock(&m_mutex);
+    return published;
+}
+
+unsigned int IngestBuffer::dropped() {
+    pthread_mutex_lock(&m_mutex);
+    unsigned int dropped = m_dropped;
+    pthread_mutex_unlock(&m_mutex);
+    return dropped;
+}
@@ -0,0 +1,98 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "culling.h"
+
+#define INGEST_SLOTS 3
+#define INGEST_MAX_PARAMS 16
+#define INGEST_MAX_INSTANCES 4096
+
+// One batch of producer data. Java sees each slot as a direct ByteBuffer
+// in native byte order, so the layout is fixed and mirrored by the
+// INGEST_* constants in NativeEglExample.java:
+//   0   uint32 instanceCount
+//   4   uint32 paramCount
+//   16  float  params[INGEST_MAX_PARAMS]
+//   80  CullObject instances[INGEST_MAX_INSTANCES] (32 bytes each)
+struct IngestSlot {
+    uint32_t instanceCount;
+    uint32_t paramCount;
+    uint32_t reserved[2];
+    GLfloat params[INGEST_MAX_PARAMS];
+    CullObject instances[INGEST_MAX_INSTANCES];
+};
+
+// Native-owned triple buffer between a producer thread (Java) and the
+// render thread. The producer fills a slot it acquired and publishes it;
+// the render thread reads the newest published slot in place. With one
+// slot being read and one waiting there is always a third one free, so
+// the producer never waits on the render thread and never has to take
+// back a published slot. Only the slot state is guarded by the mutex,
+// the payload is never copied. Nothing here touches JNI, so the same path
+// can be driven from plain C++ (see tools/ingesttest).
+class IngestBuffer {
+
+public:
+
+    enum SlotState {
+        SLOT_FREE = 0,
+        SLOT_WRITING,
+        SLOT_READY,
+        SLOT_READING
+    };
+
+    IngestBuffer();
+    virtual ~IngestBuffer();
+
+    // Producer side. acquire() returns the index of a free slot, or -1
+    // when none is free, which only happens if a producer acquires again
+    // before publishing.
+    int acquire();
+    // Hands a filled slot, identified by its base address, to the render
+    // thread. An older published slot that was never consumed is dropped.
+    bool publish(void* address);
+
+    // Render thread side. Returns the newest published slot, or 0 if
+    // nothing new arrived. A returned slot stays valid, and is never handed
+    // back to the producer, until a later call returns a newer one.
+    const IngestSlot* consume();
+
+    void* slotAddress(int slot) { return &m_slots[slot]; }
+    static size_t slotSize() { return sizeof(IngestSlot); }
+
+    // Snapshots for diagnostics and tests.
+    SlotState state(int slot);
+    unsigned int published();
+    // Published batches replaced by a newer one before being consumed.
+    unsigned int dropped();
+
+private:
+
+    pthread_mutex_t m_mutex;
+    IngestSlot* m_slots;
+    SlotState m_state[INGEST_SLOTS];
+    unsigned int m_published;
+    unsigned int m_dropped;
+};
+
+#endif // INGEST_H
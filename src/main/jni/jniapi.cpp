@@ -28,6 +28,8 @@
 
 static ANativeWindow *window = 0;
 static Renderer *renderer = 0;
+// direct ByteBuffer views of the ingest slots, created once per renderer
+static jobject ingestViews[INGEST_SLOTS];
 
 JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeOnStart(JNIEnv* jenv, jobject obj)
 {
@@ -53,6 +55,12 @@ JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeOnPa
 JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeOnStop(JNIEnv* jenv, jobject obj)
 {
     LOG_INFO("nativeOnStop");
+    for (int i = 0; i < INGEST_SLOTS; i++) {
+        if (ingestViews[i]) {
+            jenv->DeleteGlobalRef(ingestViews[i]);
+            ingestViews[i] = 0;
+        }
+    }
     delete renderer;
     renderer = 0;
     return;
@@ -65,6 +73,38 @@ JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeChan
     return;
 }
 
+// Returns a free ingest slot as a direct ByteBuffer over native memory, or
+// null if none is free. Java fills it in place (native byte order) and
+// hands it back with nativeIngestPublish, so a whole batch of scene data
+// costs two JNI calls and no copies.
+JNIEXPORT jobject JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeIngestAcquire(JNIEnv* jenv, jobject obj)
+{
+    int slot = renderer->ingest().acquire();
+    if (slot < 0) {
+        return 0;
+    }
+    if (!ingestViews[slot]) {
+        jobject view = jenv->NewDirectByteBuffer(renderer->ingest().slotAddress(slot),
+                                                 IngestBuffer::slotSize());
+        if (!view) {
+            return 0;
+        }
+        ingestViews[slot] = jenv->NewGlobalRef(view);
+        jenv->DeleteLocalRef(view);
+    }
+    return ingestViews[slot];
+}
+
+JNIEXPORT jboolean JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeIngestPublish(JNIEnv* jenv, jobject obj, jobject buffer)
+{
+    void* address = jenv->GetDirectBufferAddress(buffer);
+    if (!address) {
+        LOG_ERROR("nativeIngestPublish: not a direct buffer");
+        return JNI_FALSE;
+    }
+    return renderer->ingest().publish(address) ? JNI_TRUE : JNI_FALSE;
+}
+
 JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeSetSurface(JNIEnv* jenv, jobject obj, jobject surface)
 {
     if (surface != 0) {
@@ -23,6 +23,9 @@ extern "C" {
     JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeOnPause(JNIEnv* jenv, jobject obj);
     JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeOnStop(JNIEnv* jenv, jobject obj);
     JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeSetSurface(JNIEnv* jenv, jobject obj, jobject surface);
+    JNIEXPORT void JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeChangeMode(JNIEnv* jenv, jobject obj);
+    JNIEXPORT jobject JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeIngestAcquire(JNIEnv* jenv, jobject obj);
+    JNIEXPORT jboolean JNICALL Java_tsaarni_nativeeglexample_NativeEglExample_nativeIngestPublish(JNIEnv* jenv, jobject obj, jobject buffer);
 };
 
 #endif // JNIAPI_H
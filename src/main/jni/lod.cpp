@@ -0,0 +1,242 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lod.h"
+
+LodSelector::LodSelector()
+        : m_levelCount(0), m_threshold(1.0f), m_hysteresis(0.25f), m_budget(0),
+          m_capacity(0), m_count(0), m_current(0), m_next(0), m_scale(0), m_order(0),
+          m_visible(0), m_triangles(0), m_effective(0.0f) {
+    memset(m_levelUse, 0, sizeof(m_levelUse));
+}
+
+LodSelector::~LodSelector() {
+    delete[] m_current;
+    delete[] m_next;
+    delete[] m_scale;
+    delete[] m_order;
+}
+
+void LodSelector::setLevels(const LodLevel* levels, GLuint count) {
+    m_levelCount = count < LOD_MAX_LEVELS ? count : LOD_MAX_LEVELS;
+    memcpy(m_levels, levels, m_levelCount * sizeof(LodLevel));
+    // forget the history, the old level numbers mean nothing now
+    m_count = 0;
+}
+
+GLuint LodSelector::select(const CullObject* objects, GLuint count,
+                           const GLfloat viewProj[16], GLint width, GLint height) {
+    if (count > m_capacity) {
+        delete[] m_current;
+        delete[] m_next;
+        delete[] m_scale;
+        delete[] m_order;
+        m_capacity = count;
+        m_current = new unsigned char[count];
+        m_next = new unsigned char[count];
+        m_scale = new GLfloat[count];
+        m_order = new GLfloat[count];
+    }
+    if (count != m_count) {
+        memset(m_current, LOD_CULLED, count);
+        m_count = count;
+    }
+
+    GLfloat planes[24];
+    extractFrustumPlanes(viewProj, planes);
+
+    const GLfloat* m = viewProj;
+    GLfloat pixelScale = lodPixelScale(viewProj, width, height);
+
+    m_visible = 0;
+    GLuint coarsest = 0;
+    for (GLuint i = 0; i < count; i++) {
+        const CullObject& o = objects[i];
+        if (m_levelCount == 0 || !sphereInFrustum(planes, o.center, o.radius)) {
+            m_scale[i] = -1.0f;
+            continue;
+        }
+        GLfloat w = m[3] * o.center[0] + m[7] * o.center[1] + m[11] * o.center[2] + m[15];
+        // closer than its own radius the projection breaks down; clamp
+        // there so the scale stays finite and a raised threshold can still
+        // coarsen the object
+        GLfloat d = w > o.radius ? w : o.radius;
+        m_scale[i] = d > 0.0f ? o.radius * pixelScale / d : 0.0f;
+        m_visible++;
+    }
+    if (m_levelCount) {
+        coarsest = m_visible * (m_levels[m_levelCount - 1].indexCount / 3);
+    }
+
+    GLfloat threshold = m_threshold;
+    GLuint triangles = choose(threshold);
+    if (m_budget && triangles > m_budget) {
+        // the triangle count only falls as the threshold rises: find a
+        // threshold that fits, then narrow it down
+        GLfloat lo = threshold;
+        GLfloat hi = threshold;
+        if (coarsest <= m_budget) {
+            for (int i = 0; i < 32 && triangles > m_budget; i++) {
+                lo = hi;
+                hi *= 2.0f;
+                triangles = choose(hi);
+            }
+        }
+        if (triangles <= m_budget) {
+            for (int i = 0; i < 8; i++) {
+                GLfloat mid = 0.5f * (lo + hi);
+                if (choose(mid) > m_budget) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            threshold = hi;
+            triangles = choose(threshold);
+        } else {
+            // the budget cannot be met, or no threshold was found that
+            // meets it: everything goes to the coarsest level and what
+            // still does not fit is dropped
+            threshold = FLT_MAX;
+            triangles = chooseCoarsest();
+        }
+    }
+
+    unsigned char* swap = m_current;
+    m_current = m_next;
+    m_next = swap;
+
+    memset(m_levelUse, 0, sizeof(m_levelUse));
+    for (GLuint i = 0; i < count; i++) {
+        if (m_current[i] != LOD_CULLED) {
+            m_levelUse[m_current[i]]++;
+        }
+    }
+    m_triangles = triangles;
+    m_effective = threshold;
+    return triangles;
+}
+
+// Fills m_next for the given threshold and returns the triangle total.
+GLuint LodSelector::choose(GLfloat threshold) {
+    GLfloat coarsen = threshold * (1.0f - m_hysteresis);
+    GLuint triangles = 0;
+
+    for (GLuint i = 0; i < m_count; i++) {
+        GLfloat scale = m_scale[i];
+        if (scale < 0.0f) {
+            m_next[i] = LOD_CULLED;
+            continue;
+        }
+        GLuint desired = 0;
+        for (GLuint l = m_levelCount; l-- > 0;) {
+            if (m_levels[l].error * scale <= threshold) {
+                desired = l;
+                break;
+            }
+        }
+        // an object may always refine, but only moves to a coarser level
+        // once that level is comfortably under the threshold
+        GLuint level = desired;
+        GLuint previous = m_current[i];
+        if (previous != LOD_CULLED && previous < desired) {
+            level = previous;
+            for (GLuint l = desired; l > previous; l--) {
+                if (m_levels[l].error * scale <= coarsen) {
+                    level = l;
+                    break;
+                }
+            }
+        }
+        m_next[i] = (unsigned char) level;
+        triangles += m_levels[level].indexCount / 3;
+    }
+    return triangles;
+}
+
+static int compareDescending(const void* a, const void* b) {
+    GLfloat x = *(const GLfloat*) a;
+    GLfloat y = *(const GLfloat*) b;
+    return x > y ? -1 : x < y ? 1 : 0;
+}
+
+// Fills m_next with the coarsest level for every visible object, ignoring
+// hysteresis, culls the objects smallest on screen while the total is over
+// budget and returns the triangle total. Ties at the cut go to the lower
+// index.
+GLuint LodSelector::chooseCoarsest() {
+    GLuint levelTriangles = m_levels[m_levelCount - 1].indexCount / 3;
+    GLuint keep = m_visible;
+    if (m_budget && levelTriangles && m_budget / levelTriangles < keep) {
+        keep = m_budget / levelTriangles;
+    }
+
+    // smallest scale still drawn, and how many objects at exactly that
+    // scale fit
+    bool drop = keep < m_visible;
+    GLfloat cutoff = FLT_MAX;
+    GLuint ties = 0;
+    if (drop && keep > 0) {
+        GLuint n = 0;
+        for (GLuint i = 0; i < m_count; i++) {
+            if (m_scale[i] >= 0.0f) {
+                m_order[n++] = m_scale[i];
+            }
+        }
+        qsort(m_order, n, sizeof(GLfloat), compareDescending);
+        cutoff = m_order[keep - 1];
+        for (GLuint i = keep; i-- > 0 && m_order[i] == cutoff;) {
+            ties++;
+        }
+    }
+
+    GLuint triangles = 0;
+    m_visible = 0;
+    for (GLuint i = 0; i < m_count; i++) {
+        GLfloat scale = m_scale[i];
+        bool drawn = scale >= 0.0f;
+        if (drawn && drop) {
+            if (scale < cutoff) {
+                drawn = false;
+            } else if (scale == cutoff) {
+                drawn = ties > 0;
+                ties -= drawn ? 1 : 0;
+            }
+        }
+        if (!drawn) {
+            m_next[i] = LOD_CULLED;
+            continue;
+        }
+        m_next[i] = (unsigned char) (m_levelCount - 1);
+        triangles += levelTriangles;
+        m_visible++;
+    }
+    return triangles;
+}
+
+GLfloat lodPixelScale(const GLfloat viewProj[16], GLint width, GLint height) {
+    // a world space length l at clip w covers about l * pixelScale / w
+    // pixels; rows 0 and 1 of the column-major matrix map to x and y
+    const GLfloat* m = viewProj;
+    GLfloat sx = 0.5f * width * sqrtf(m[0] * m[0] + m[4] * m[4] + m[8] * m[8]);
+    GLfloat sy = 0.5f * height * sqrtf(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]);
+    return sx > sy ? sx : sy;
+}
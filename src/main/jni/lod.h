@@ -0,0 +1,107 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef LOD_H
+#define LOD_H
+
+#include <GLES3/gl3.h>
+
+#include "culling.h"
+
+#define LOD_MAX_LEVELS 8
+#define LOD_CULLED 0xff
+
+// One detail level of a mesh: an index range of the shared vertex data
+// and its geometric error for an instance of radius 1.
+struct LodLevel {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLfloat error;
+};
+
+// Per-frame level of detail selection for a set of instances of one mesh.
+// Every visible object gets the coarsest level whose error, projected to
+// the screen, stays under a pixel threshold. Hysteresis stops objects near
+// a boundary from switching back and forth, and when the result would
+// exceed the triangle budget the threshold is raised until it fits. The
+// budget is a hard limit: if even the coarsest level is over it, the
+// objects smallest on screen are not drawn.
+class LodSelector {
+
+public:
+    LodSelector();
+    virtual ~LodSelector();
+
+    // Levels must be ordered finest first with non-decreasing error.
+    void setLevels(const LodLevel* levels, GLuint count);
+    // Pixels of error allowed before a finer level is used (default 1),
+    // fraction below the threshold an object must reach before it moves
+    // to a coarser level (default 0.25), and triangles allowed per frame
+    // (default unlimited).
+    void setThreshold(GLfloat pixels) { m_threshold = pixels; }
+    void setHysteresis(GLfloat fraction) { m_hysteresis = fraction; }
+    void setBudget(GLuint triangles) { m_budget = triangles; }
+    GLfloat threshold() const { return m_threshold; }
+    GLfloat hysteresis() const { return m_hysteresis; }
+    GLuint budget() const { return m_budget; }
+
+    // Picks a level for each object, or LOD_CULLED when it is outside the
+    // frustum. Objects are matched to last frame's choice by position in
+    // the array; a different count starts over without hysteresis. When no
+    // threshold meets the budget every visible object gets the coarsest
+    // level, and those smallest on screen are culled (LOD_CULLED) until the
+    // rest fit. Returns the number of triangles selected.
+    GLuint select(const CullObject* objects, GLuint count,
+                  const GLfloat viewProj[16], GLint width, GLint height);
+
+    const unsigned char* levels() const { return m_current; }
+    const LodLevel& level(GLuint i) const { return m_levels[i]; }
+    GLuint levelCount() const { return m_levelCount; }
+
+    // results of the last select(); visible counts the objects drawn
+    GLuint visibleCount() const { return m_visible; }
+    GLuint triangleCount() const { return m_triangles; }
+    GLfloat effectiveThreshold() const { return m_effective; }
+    GLuint levelUseCount(GLuint i) const { return m_levelUse[i]; }
+
+private:
+    LodLevel m_levels[LOD_MAX_LEVELS];
+    GLuint m_levelCount;
+    GLfloat m_threshold;
+    GLfloat m_hysteresis;
+    GLuint m_budget;
+
+    GLuint m_capacity;
+    GLuint m_count;
+    unsigned char* m_current;  // level per object, kept across frames
+    unsigned char* m_next;
+    GLfloat* m_scale;          // pixels per unit of level error, per object
+    GLfloat* m_order;          // visible scales, largest first, for the budget
+
+    GLuint m_visible;
+    GLuint m_triangles;
+    GLfloat m_effective;
+    GLuint m_levelUse[LOD_MAX_LEVELS];
+
+    GLuint choose(GLfloat threshold);
+    GLuint chooseCoarsest();
+};
+
+// Pixels covered by a world space length of 1 at clip w = 1 with the given
+// view-projection and viewport, the larger of the x and y scales.
+GLfloat lodPixelScale(const GLfloat viewProj[16], GLint width, GLint height);
+
+#endif // LOD_H
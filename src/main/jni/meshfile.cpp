@@ -0,0 +1,210 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <GLES3/gl3.h>
+
+#include "logger.h"
+#include "meshfile.h"
+#include "glcapture.h"
+
+#define LOG_TAG "EglSample"
+
+static bool sectionFits(uint32_t offset, uint64_t size, size_t fileSize) {
+    return (offset % MESH_ALIGN) == 0 && offset >= sizeof(MeshFileHeader) &&
+           (uint64_t) offset + size <= fileSize;
+}
+
+MeshFile::MeshFile()
+        : m_map(0), m_size(0), m_header(0), m_lods(0), m_meshlets(0),
+          m_vao(0), m_vbo(0), m_ibo(0) {
+}
+
+MeshFile::~MeshFile() {
+    close();
+}
+
+bool MeshFile::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        LOG_INFO("MeshFile: cannot open %s", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(MeshFileHeader)) {
+        LOG_ERROR("MeshFile: %s is too small", path);
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("MeshFile: mmap of %s failed", path);
+        return false;
+    }
+    // everything is read front to back exactly once, by upload()
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    m_map = (const unsigned char*) map;
+    m_size = st.st_size;
+    m_header = (const MeshFileHeader*) m_map;
+    if (!validate()) {
+        LOG_ERROR("MeshFile: %s is not a valid version %d mesh", path, MESH_VERSION);
+        close();
+        return false;
+    }
+    m_lods = (const MeshLod*) (m_map + m_header->lodOffset);
+    m_meshlets = (const MeshMeshlet*) (m_map + m_header->meshletOffset);
+
+    LOG_INFO("MeshFile: %s, %u vertices, %u indices (%u bit), %u LODs, %u meshlets",
+             path, m_header->vertexCount, m_header->indexCount, m_header->indexSize * 8,
+             m_header->lodCount, m_header->meshletCount);
+    return true;
+}
+
+void MeshFile::close() {
+    if (m_map) {
+        munmap((void*) m_map, m_size);
+    }
+    m_map = 0;
+    m_size = 0;
+    m_header = 0;
+    m_lods = 0;
+    m_meshlets = 0;
+}
+
+// Checks the structure and that every index addresses a vertex, so a
+// damaged file cannot make the GPU fetch past the vertex buffer. The index
+// scan is the one pass over the section before upload() hands it over.
+bool MeshFile::validate() const {
+    const MeshFileHeader& h = *m_header;
+    if (h.magic != MESH_MAGIC || h.version != MESH_VERSION || h.fileSize != m_size) {
+        return false;
+    }
+    if ((h.indexSize != 2 && h.indexSize != 4) || h.vertexCount == 0 ||
+        (h.indexSize == 2 && h.vertexCount > 0xffff)) {
+        return false;
+    }
+    if (h.lodCount == 0 || h.lodCount > MESH_MAX_LODS) {
+        return false;
+    }
+    if (!sectionFits(h.vertexOffset, (uint64_t) h.vertexCount * sizeof(MeshVertex), m_size) ||
+        !sectionFits(h.indexOffset, (uint64_t) h.indexCount * h.indexSize, m_size) ||
+        !sectionFits(h.lodOffset, (uint64_t) h.lodCount * sizeof(MeshLod), m_size) ||
+        !sectionFits(h.meshletOffset, (uint64_t) h.meshletCount * sizeof(MeshMeshlet), m_size)) {
+        return false;
+    }
+    // sections must not overlap and come in the documented order, upload()
+    // relies on the tables following the geometry
+    if (h.indexOffset < h.vertexOffset + (uint64_t) h.vertexCount * sizeof(MeshVertex) ||
+        h.lodOffset < h.indexOffset + (uint64_t) h.indexCount * h.indexSize ||
+        h.meshletOffset < h.lodOffset + (uint64_t) h.lodCount * sizeof(MeshLod)) {
+        return false;
+    }
+
+    const MeshLod* lods = (const MeshLod*) (m_map + h.lodOffset);
+    const MeshMeshlet* meshlets = (const MeshMeshlet*) (m_map + h.meshletOffset);
+    for (uint32_t i = 0; i < h.lodCount; i++) {
+        const MeshLod& lod = lods[i];
+        if ((uint64_t) lod.firstIndex + lod.indexCount > h.indexCount || lod.indexCount % 3 ||
+            (uint64_t) lod.firstMeshlet + lod.meshletCount > h.meshletCount) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.meshletCount; i++) {
+        if ((uint64_t) meshlets[i].firstIndex + meshlets[i].indexCount > h.indexCount) {
+            return false;
+        }
+    }
+
+    uint32_t maxIndex = 0;
+    if (h.indexSize == 2) {
+        const uint16_t* indices = (const uint16_t*) (m_map + h.indexOffset);
+        for (uint32_t i = 0; i < h.indexCount; i++) {
+            maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+        }
+    } else {
+        const uint32_t* indices = (const uint32_t*) (m_map + h.indexOffset);
+        for (uint32_t i = 0; i < h.indexCount; i++) {
+            maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+        }
+    }
+    return h.indexCount == 0 || maxIndex < h.vertexCount;
+}
+
+GLenum MeshFile::indexType() const {
+    return m_header->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+bool MeshFile::upload(GLuint positionAttrib, GLuint normalAttrib, GLuint texcoordAttrib) {
+    if (!m_map) {
+        return false;
+    }
+    destroy();
+
+    const MeshFileHeader& h = *m_header;
+    GLsizeiptr vertexBytes = (GLsizeiptr) h.vertexCount * sizeof(MeshVertex);
+    GLsizeiptr indexBytes = (GLsizeiptr) h.indexCount * h.indexSize;
+
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, m_map + h.vertexOffset, GL_STATIC_DRAW);
+    glGenBuffers(1, &m_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, m_map + h.indexOffset, GL_STATIC_DRAW);
+
+    GLsizei stride = sizeof(MeshVertex);
+    glEnableVertexAttribArray(positionAttrib);
+    glVertexAttribPointer(positionAttrib, 4, GL_HALF_FLOAT, GL_FALSE, stride,
+                          (const void*) offsetof(MeshVertex, position));
+    glEnableVertexAttribArray(normalAttrib);
+    glVertexAttribPointer(normalAttrib, 2, GL_SHORT, GL_TRUE, stride,
+                          (const void*) offsetof(MeshVertex, normal));
+    glEnableVertexAttribArray(texcoordAttrib);
+    glVertexAttribPointer(texcoordAttrib, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                          (const void*) offsetof(MeshVertex, texcoord));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // the driver has its copy; the pages are clean and can be dropped now,
+    // only the small LOD and meshlet tables are read again
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t) (m_map + h.vertexOffset) + page - 1) & ~(uintptr_t) (page - 1);
+    uintptr_t end = (uintptr_t) (m_map + h.indexOffset + indexBytes) & ~(uintptr_t) (page - 1);
+    if (begin < end) {
+        madvise((void*) begin, end - begin, MADV_DONTNEED);
+    }
+    return true;
+}
+
+void MeshFile::destroy() {
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ibo);
+    m_vao = 0;
+    m_vbo = 0;
+    m_ibo = 0;
+}
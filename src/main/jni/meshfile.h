@@ -0,0 +1,71 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <stddef.h>
+#include <GLES3/gl3.h>
+
+#include "meshformat.h"
+
+// Mesh loaded from a meshformat.h container. The file is mapped read-only
+// and its vertex and index sections are passed to glBufferData directly
+// from the mapping, so loading does no parsing and no intermediate copy.
+// The LOD and meshlet tables are read in place and stay valid until
+// close().
+class MeshFile {
+
+public:
+    MeshFile();
+    virtual ~MeshFile();
+
+    // Maps and validates the file. Does not need a GL context.
+    bool open(const char* path);
+    void close();
+
+    // Creates a VAO with the vertex and index buffers and the three vertex
+    // attributes enabled at the given locations. Requires a current GLES 3
+    // context; the VAO and buffers are owned by the caller's context and
+    // released by destroy().
+    bool upload(GLuint positionAttrib, GLuint normalAttrib, GLuint texcoordAttrib);
+    void destroy();
+
+    GLuint vao() const { return m_vao; }
+    GLenum indexType() const;
+    GLuint vertexCount() const { return m_header->vertexCount; }
+    GLuint lodCount() const { return m_header->lodCount; }
+    const MeshLod& lod(GLuint i) const { return m_lods[i]; }
+    GLuint meshletCount() const { return m_header->meshletCount; }
+    const MeshMeshlet* meshlets() const { return m_meshlets; }
+    const GLfloat* center() const { return m_header->center; }
+    GLfloat radius() const { return m_header->radius; }
+
+private:
+    const unsigned char* m_map;
+    size_t m_size;
+    const MeshFileHeader* m_header;
+    const MeshLod* m_lods;
+    const MeshMeshlet* m_meshlets;
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+
+    bool validate() const;
+};
+
+#endif // MESHFILE_H
@@ -0,0 +1,96 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef MESHFORMAT_H
+#define MESHFORMAT_H
+
+#include <stdint.h>
+
+// Binary mesh container shared by the runtime loader (meshfile.cpp) and
+// the offline converter (tools/meshconv). Everything is little endian and
+// laid out so the vertex and index sections can be handed to
+// glBufferData straight from a read-only mapping of the file.
+//
+// File:  MeshFileHeader, then the sections at the offsets it names, in
+//        this order and each aligned to MESH_ALIGN:
+//          vertices  MeshVertex[vertexCount]
+//          indices   u16 or u32 [indexCount], every LOD back to back
+//          lods      MeshLod[lodCount], finest first
+//          meshlets  MeshMeshlet[meshletCount], grouped by LOD
+//
+// All LODs index the same vertex array. Each LOD's triangles are ordered
+// for the post-transform vertex cache, and vertices are ordered by first
+// use in LOD 0.
+
+#define MESH_MAGIC 0x48534d47 // "GMSH"
+#define MESH_VERSION 1
+#define MESH_ALIGN 16
+
+#define MESH_MAX_LODS 8
+#define MESH_MESHLET_MAX_VERTICES 64
+#define MESH_MESHLET_MAX_TRIANGLES 124
+
+// 16 bytes, read as three vertex attributes:
+//   position  GL_HALF_FLOAT x4 (w is 1.0)
+//   normal    GL_SHORT x2 normalized, octahedral encoding
+//   texcoord  GL_HALF_FLOAT x2
+struct MeshVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texcoord[2];
+};
+
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    // largest object space distance between a vertex of the full mesh and
+    // the surface of this LOD; 0 for LOD 0
+    float error;
+    uint32_t reserved[3];
+};
+
+// A cluster of at most MESH_MESHLET_MAX_TRIANGLES triangles touching at
+// most MESH_MESHLET_MAX_VERTICES vertices, drawable as a range of the
+// index buffer and cullable by its bounding sphere.
+struct MeshMeshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float center[3];
+    float radius;
+};
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t indexSize;    // 2 or 4 bytes
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t vertexOffset;
+    uint32_t indexOffset;
+    uint32_t lodOffset;
+    uint32_t meshletOffset;
+    uint32_t fileSize;
+    uint32_t reserved;
+    // bounding sphere of the mesh in object space
+    float center[3];
+    float radius;
+};
+
+#endif // MESHFORMAT_H
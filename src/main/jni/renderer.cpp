@@ -15,6 +15,10 @@
 //
 
 #include <stdint.h>
+#include <stdio.h>
+#include <float.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <android/native_window.h> // requires ndk r5 or newer
@@ -22,6 +26,7 @@
 
 #include "logger.h"
 #include "renderer.h"
+#include "glcapture.h"
 
 #define LOG_TAG "EglSample"
 
@@ -41,20 +46,83 @@ const char *fragmentSrc =
                 "  gl_FragColor = vec4(0.0,1.0,0.0,1.0);           \n"
                 "}                                  \n";
 
+// instanced scene shader, the per-instance attribute is (center, scale).
+// uMeshBounds (center, 1 / radius) fits the mesh into the unit sphere and
+// vNormal is octahedral encoded (see meshformat.h); a disabled normal
+// array reads as (0, 0), which decodes to +z.
+const char *sceneVertexSrc =
+        "#version 300 es                    \n"
+                "layout(location = 0) in vec4 vPosition;\n"
+                "layout(location = 1) in vec2 vNormal;\n"
+                "layout(location = 2) in vec4 vInstance;\n"
+                "uniform mat4 uMVPMatrix;           \n"
+                "uniform vec4 uMeshBounds;          \n"
+                "out float vShade;                  \n"
+                "vec3 octDecode(vec2 e) {           \n"
+                "  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+                "  if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);\n"
+                "  return normalize(n);             \n"
+                "}                                  \n"
+                "void main() {                      \n"
+                "  vec3 p = (vPosition.xyz - uMeshBounds.xyz) * uMeshBounds.w;\n"
+                "  gl_Position = uMVPMatrix * vec4(p * vInstance.w + vInstance.xyz, 1.0);\n"
+                "  vShade = 0.4 + 0.6 * max(octDecode(vNormal).z, 0.0);\n"
+                "}                                  \n";
+
+const char *sceneFragmentSrc =
+        "#version 300 es                    \n"
+                "precision mediump float;           \n"
+                "uniform vec4 vColor;               \n"
+                "in float vShade;                   \n"
+                "out vec4 fragColor;                \n"
+                "void main() {                      \n"
+                "  fragColor = vec4(vColor.rgb * vShade, vColor.a);\n"
+                "}                                  \n";
+
+#define SCENE_POSITION_ATTRIB 0
+#define SCENE_NORMAL_ATTRIB 1
+#define SCENE_INSTANCE_ATTRIB 2
+#define SCENE_TEXCOORD_ATTRIB 3
+
+const GLfloat landscapeOrientationMatrix[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f };
+
 static void buildShader ();
 //static void bindProg();
 
 Renderer::Renderer()
-        : _msg(MSG_NONE), _display(0), _surface(0), _context(0), _angle(0) {
+        : _msg(MSG_NONE), _display(0), _surface(0), _context(0), _angle(0),
+          m_sceneProgram(0), m_sceneVao(0), m_sceneVbo(0), m_sceneIbo(0),
+          m_sceneIndexType(GL_UNSIGNED_SHORT),
+          m_objects(0), m_objectCount(0), m_ingestObjects(0), m_ingestCount(0),
+          m_gpuCullingSupported(false), m_gpuCulling(false), m_frame(0) {
+#ifdef LOD_BENCHMARK
+    m_coverageFbo = 0;
+    m_coverageColor = 0;
+    m_coverageWidth = 0;
+    m_coverageHeight = 0;
+    m_coveragePixels = 0;
+#endif
     LOG_INFO("Renderer instance created");
 //    OPENMSAA = false;
     pthread_mutex_init(&_mutex, 0);
+    m_sceneColor[0] = 0.2f;
+    m_sceneColor[1] = 0.4f;
+    m_sceneColor[2] = 1.0f;
+    m_sceneColor[3] = 1.0f;
     return;
 }
 
 Renderer::~Renderer() {
     LOG_INFO("Renderer instance destroyed");
     pthread_mutex_destroy(&_mutex);
+    delete[] m_objects;
+#ifdef LOD_BENCHMARK
+    delete[] m_coveragePixels;
+#endif
     return;
 }
 
@@ -78,6 +146,15 @@ void Renderer::stop() {
     return;
 }
 
+void Renderer::changeMode() {
+    pthread_mutex_lock(&_mutex);
+    m_gpuCulling = m_gpuCullingSupported && !m_gpuCulling;
+    LOG_INFO("Scene culling: %s", m_gpuCulling ? "GPU" : "CPU");
+    pthread_mutex_unlock(&_mutex);
+
+    return;
+}
+
 void Renderer::setWindow(ANativeWindow *window) {
     // notify render thread that window has changed
     pthread_mutex_lock(&_mutex);
@@ -93,13 +170,23 @@ void Renderer::setWindow(ANativeWindow *window) {
 void Renderer::renderLoop() {
     bool renderingEnabled = true;
     LOG_INFO("renderLoop()");
+#ifdef GL_CAPTURE
+    GlCapture::begin(GL_CAPTURE_PATH, GL_CAPTURE_FRAMES);
+#endif
     while (renderingEnabled) {
         pthread_mutex_lock(&_mutex);
         // process incoming messages
         switch (_msg) {
             case MSG_WINDOW_SET:
+                // the pooled render targets, the scene and the culler all
+                // belong to the old context; free them while it is current
+                // rather than let the new context reuse stale names
+                if (_context != EGL_NO_CONTEXT) {
+                    destroy();
+                }
                 initialize();
                 initShader();
+                initScene();
                 break;
             case MSG_RENDER_LOOP_EXIT:
                 renderingEnabled = false;
@@ -117,6 +204,9 @@ void Renderer::renderLoop() {
         }
         pthread_mutex_unlock(&_mutex);
     }
+#ifdef GL_CAPTURE
+    GlCapture::end();
+#endif
     LOG_INFO("Render loop exits");
     return;
 }
@@ -136,14 +226,16 @@ bool Renderer::initialize() {
 
     const EGLint attribs[] = {
     //        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
             EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
             EGL_BLUE_SIZE, 8,
             EGL_GREEN_SIZE, 8,
             EGL_RED_SIZE, 8,
             EGL_ALPHA_SIZE, 8,
-            EGL_SAMPLE_BUFFERS, 1,
-            EGL_SAMPLES, 4,
+            // with offscreen MSAA the render graph resolves into the surface,
+            // and blitting into a multisampled surface is invalid
+            EGL_SAMPLE_BUFFERS, OPENMSAA ? 0 : 1,
+            EGL_SAMPLES, OPENMSAA ? 0 : 4,
             EGL_NONE
     };
 
@@ -247,7 +339,7 @@ bool Renderer::initialize() {
     }
 
     EGLint contextAttribList[] = {
-            EGL_CONTEXT_CLIENT_VERSION, 2,
+            EGL_CONTEXT_CLIENT_VERSION, 3,
             EGL_NONE
     };
     //if (!(context = eglCreateContext(display, config, 0, 0))) {
@@ -301,10 +393,7 @@ bool Renderer::initialize() {
 //    glFrustumf(-ratio, ratio, -1, 1, 1, 10);
      */
     delete configs_list;
-    if (OPENMSAA)
-    {
-        MultisampleAntiAliasing();
-    }
+    buildRenderGraph();
 
     return true;
 }
@@ -312,6 +401,12 @@ bool Renderer::initialize() {
 void Renderer::destroy() {
     LOG_INFO("Destroying context");
 
+    if (_context != EGL_NO_CONTEXT) {
+        destroyScene();
+        m_graph.destroy();
+        m_graph.reset();
+    }
+
     eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroyContext(_display, _context);
     eglDestroySurface(_display, _surface);
@@ -326,18 +421,21 @@ void Renderer::destroy() {
 
 void Renderer::drawFrame() {
     //LOG_INFO("drawFrame %d x %d", width, height);
+
+    m_graph.execute();
+    checkGLError("RenderGraph");
+}
+
+void Renderer::mainPassCallback(void *myself) {
+    Renderer *renderer = (Renderer *) myself;
+    renderer->mainPass();
+}
+
+void Renderer::mainPass() {
     static float r=0.9f;
     static float g=0.2f;
     static float b=0.2f;
 
-    LOG_INFO("xxx %d, %d", m_width,m_height);
-    if (OPENMSAA)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_MSFBO);
-        glBindRenderbuffer(GL_RENDERBUFFER, m_MSColor);
-        checkGLError("BindTwoBuffers");
-    }
-
     glViewport(0,0,m_width,m_height);
     glScissor(0,0,m_width,m_height);
 
@@ -365,11 +463,6 @@ void Renderer::drawFrame() {
 //    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, indices);
 //    _angle += 1.2f;
 */
-    const GLfloat landscapeOrientationMatrix[16] = {
-            1.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 1.0f };
     const GLfloat color[4] = {
             1.0f, 0.0f, 0.0f, 1.0f
     };
@@ -385,23 +478,10 @@ void Renderer::drawFrame() {
 //    glLineWidth(80);
     glDrawArrays(GL_POINTS, 0, 4);
     glDisableVertexAttribArray( m_p );
-    glFlush();
-    checkGLError("Before Blit");
-    if (OPENMSAA)
-    {
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_MSFBO);
-        checkGLError("BindReadBuffer");
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-//        glDrawBuffers(1, GL_BACK);
-        checkGLError("BindFramebuffer");
-        glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-        checkGLError("BlitFramebufferColor");
-        glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-        checkGLError("BlitFramebufferDepth");
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    }
 
+    drawScene(landscapeOrientationMatrix);
+    glFlush();
+    checkGLError("MainPass");
 }
 
 void *Renderer::threadStartCallback(void *myself) {
@@ -491,45 +571,32 @@ void Renderer::initShader() {
     m_uColor = glGetUniformLocation( m_program, "vColor");
 }
 
-void Renderer::MultisampleAntiAliasing() {
-/*/    glGenRenderbuffers(1, defaultRenderbuffer);
-//    glBindRenderbuffer(GL_RENDERBUFFER, defaultRenderbuffer[0]);
-//    //[context renderbufferStorage:GL_RENDERBUFFER fromDrawable:layer];
-//    LOG_INFO("GenRenderbuffers");
-//
-//    glGenFramebuffers(1, defaultFramebuffer);
-//    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer[0]);
-//    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, defaultRenderbuffer[0]);
-//    LOG_INFO("GenFramebuffers");
-//
-//    LOG_INFO("SetWH");
-*/
-    glGenRenderbuffers(1, &m_MSColor);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_MSColor);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_RGBA8, m_width, m_height);
-    checkGLError("GenMSColorBuffer");
-
-    glGenFramebuffers(1, &m_MSFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_MSFBO);
-
-
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_MSColor);
-    checkGLError("FboRbo,COLORATTACHMENT");
-
-    glGenRenderbuffers(1, &m_MSDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_MSDepth);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT16, m_width, m_height);
-    checkGLError("GenDepthBuffer");
-
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_MSDepth);
-    checkGLError("DepthBuffer,Renderbuffer");
-    GLenum drawBufs[] = {GL_COLOR_ATTACHMENT0};
-    glDrawBuffers(1, drawBufs);
-    checkGLError("DrawBuffer");
+void Renderer::buildRenderGraph() {
+    // Passes only declare targets; the graph allocates them from its pool,
+    // resolves multisampled color into the backbuffer and discards depth.
+    // Post-processing passes read() the previous pass output and write()
+    // new transient targets of their own.
+    m_graph.reset();
+    RenderResource backbuffer = m_graph.backbuffer(m_width, m_height);
+    int mainPass = m_graph.addPass("main", mainPassCallback, this);
+    if (OPENMSAA)
+    {
+        RenderResource color = m_graph.createTarget("msaa color", m_width, m_height, GL_RGBA8, 4);
+        RenderResource depth = m_graph.createTarget("msaa depth", m_width, m_height, GL_DEPTH_COMPONENT16, 4);
+        m_graph.write(mainPass, color);
+        m_graph.write(mainPass, depth);
+        m_graph.present(color);
+    }
+    else
+    {
+        m_graph.write(mainPass, backbuffer);
+        m_graph.present(backbuffer);
+    }
 
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        LOG_ERROR("failed to make complete framebuffer object %x", glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    if (!m_graph.compile()) {
+        LOG_ERROR("failed to compile render graph");
     }
+    checkGLError("BuildRenderGraph");
 }
 
 void Renderer::checkGLError(const char* str) {
@@ -557,4 +624,339 @@ void Renderer::checkGLError(const char* str) {
             LOG_INFO("SOMETHING_WRONG  %s", str);
             break;
     }
-}
\ No newline at end of file
+}
+
+void Renderer::initScene() {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    LOG_INFO("GL version: %s (%d.%d)", glGetString(GL_VERSION), major, minor);
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    if (!CompileShader(vs, sceneVertexSrc) || !CompileShader(fs, sceneFragmentSrc)) {
+        LOG_ERROR("Failed to compile scene shaders");
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return;
+    }
+    m_sceneProgram = glCreateProgram();
+    glAttachShader(m_sceneProgram, vs);
+    glAttachShader(m_sceneProgram, fs);
+    glLinkProgram(m_sceneProgram);
+    glDetachShader(m_sceneProgram, vs);
+    glDetachShader(m_sceneProgram, fs);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint status = 0;
+    glGetProgramiv(m_sceneProgram, GL_LINK_STATUS, &status);
+    if (!status) {
+        LOG_ERROR("create scene program failed");
+        glDeleteProgram(m_sceneProgram);
+        m_sceneProgram = 0;
+        return;
+    }
+    m_uSceneMvp = glGetUniformLocation(m_sceneProgram, "uMVPMatrix");
+    m_uSceneColor = glGetUniformLocation(m_sceneProgram, "vColor");
+    m_uSceneBounds = glGetUniformLocation(m_sceneProgram, "uMeshBounds");
+
+    // indirect draws require buffer-backed vertex data in a non-zero VAO
+    if (m_mesh.open(SCENE_MESH_PATH) &&
+        m_mesh.upload(SCENE_POSITION_ATTRIB, SCENE_NORMAL_ATTRIB, SCENE_TEXCOORD_ATTRIB)) {
+        m_sceneVao = m_mesh.vao();
+        m_sceneIndexType = m_mesh.indexType();
+        // the shader fits the mesh into the unit sphere, so errors are
+        // relative to its radius
+        LodLevel levels[LOD_MAX_LEVELS];
+        GLuint levelCount = m_mesh.lodCount() < LOD_MAX_LEVELS ? m_mesh.lodCount() : LOD_MAX_LEVELS;
+        for (GLuint i = 0; i < levelCount; i++) {
+            levels[i].firstIndex = m_mesh.lod(i).firstIndex;
+            levels[i].indexCount = m_mesh.lod(i).indexCount;
+            levels[i].error = m_mesh.radius() > 0.0f ? m_mesh.lod(i).error / m_mesh.radius() : 0.0f;
+        }
+        m_lod.setLevels(levels, levelCount);
+        m_sceneBounds[0] = m_mesh.center()[0];
+        m_sceneBounds[1] = m_mesh.center()[1];
+        m_sceneBounds[2] = m_mesh.center()[2];
+        m_sceneBounds[3] = m_mesh.radius() > 0.0f ? 1.0f / m_mesh.radius() : 1.0f;
+        checkGLError("SceneMesh");
+    } else {
+        initSquare();
+    }
+
+    delete[] m_objects;
+    m_objectCount = SCENE_GRID * SCENE_GRID;
+    m_objects = new CullObject[m_objectCount];
+    for (GLuint i = 0; i < m_objectCount; i++) {
+        CullObject &o = m_objects[i];
+        o.center[0] = -SCENE_EXTENT + 2.0f * SCENE_EXTENT * (i % SCENE_GRID) / (SCENE_GRID - 1);
+        o.center[1] = -SCENE_EXTENT + 2.0f * SCENE_EXTENT * (i / SCENE_GRID) / (SCENE_GRID - 1);
+        o.center[2] = 0.0f;
+        o.radius = SCENE_SCALE;
+        o.batch = 0;
+    }
+
+    m_lod.setThreshold(SCENE_LOD_THRESHOLD);
+    m_lod.setBudget(SCENE_TRIANGLE_BUDGET);
+
+    // one indirect draw per level; the culler picks each object's level
+    // on the GPU by the same rules as m_lod on the CPU path
+    CullBatch batches[LOD_MAX_LEVELS];
+    for (GLuint i = 0; i < m_lod.levelCount(); i++) {
+        batches[i].indexCount = m_lod.level(i).indexCount;
+        batches[i].firstIndex = m_lod.level(i).firstIndex;
+    }
+
+    m_gpuCullingSupported = (major > 3 || (major == 3 && minor >= 1)) &&
+                            m_culler.initialize(m_objects, m_objectCount, batches, m_lod.levelCount());
+    if (m_gpuCullingSupported) {
+        GLfloat errors[LOD_MAX_LEVELS];
+        for (GLuint i = 0; i < m_lod.levelCount(); i++) {
+            errors[i] = m_lod.level(i).error;
+        }
+        if (!m_culler.setLod(errors, m_lod.threshold(), m_lod.hysteresis(), m_lod.budget())) {
+            m_culler.destroy();
+            m_gpuCullingSupported = false;
+        }
+    }
+    // a new context starts with empty buffers; the ingest slot already in
+    // use is not published again
+    if (m_gpuCullingSupported && m_ingestObjects) {
+        m_culler.setObjects(m_ingestObjects, m_ingestCount);
+    }
+    m_gpuCulling = m_gpuCullingSupported;
+    LOG_INFO("Scene culling: %s", m_gpuCulling ? "GPU" : "CPU");
+}
+
+void Renderer::initSquare() {
+    glGenVertexArrays(1, &m_sceneVao);
+    glBindVertexArray(m_sceneVao);
+    glGenBuffers(1, &m_sceneVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_sceneVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(squareCoords), squareCoords, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(SCENE_POSITION_ATTRIB);
+    glVertexAttribPointer(SCENE_POSITION_ATTRIB, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+    glGenBuffers(1, &m_sceneIbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sceneIbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(squareIndices), squareIndices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    checkGLError("SceneBuffers");
+
+    m_sceneIndexType = GL_UNSIGNED_SHORT;
+    LodLevel level;
+    level.firstIndex = 0;
+    level.indexCount = sizeof(squareIndices) / sizeof(squareIndices[0]);
+    level.error = 0.0f;
+    m_lod.setLevels(&level, 1);
+    m_sceneBounds[0] = 0.0f;
+    m_sceneBounds[1] = 0.0f;
+    m_sceneBounds[2] = 0.0f;
+    m_sceneBounds[3] = 1.0f;
+}
+
+void Renderer::destroyScene() {
+    if (m_gpuCullingSupported) {
+        m_culler.destroy();
+    }
+    if (m_mesh.vao()) {
+        m_mesh.destroy();
+    } else {
+        glDeleteVertexArrays(1, &m_sceneVao);
+        glDeleteBuffers(1, &m_sceneVbo);
+        glDeleteBuffers(1, &m_sceneIbo);
+    }
+    glDeleteProgram(m_sceneProgram);
+    m_sceneVao = 0;
+    m_sceneVbo = 0;
+    m_sceneIbo = 0;
+    m_sceneProgram = 0;
+#ifdef LOD_BENCHMARK
+    glDeleteFramebuffers(1, &m_coverageFbo);
+    glDeleteRenderbuffers(1, &m_coverageColor);
+    m_coverageFbo = 0;
+    m_coverageColor = 0;
+    m_coverageWidth = 0;
+    m_coverageHeight = 0;
+#endif
+    m_gpuCullingSupported = false;
+    m_gpuCulling = false;
+}
+
+void Renderer::drawScene(const GLfloat* viewProj) {
+    if (!m_sceneProgram) {
+        return;
+    }
+
+    // CPU submission cost of both paths, logged periodically for comparison
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    // pick up the newest batch from Java; instances are used straight out
+    // of the ingest slot, which stays ours until a newer one replaces it
+    const IngestSlot* slot = m_ingest.consume();
+    if (slot) {
+        GLuint count = slot->instanceCount < INGEST_MAX_INSTANCES ? slot->instanceCount : INGEST_MAX_INSTANCES;
+        if (slot->paramCount >= 4) {
+            memcpy(m_sceneColor, slot->params, sizeof(m_sceneColor));
+        }
+        m_ingestObjects = slot->instances;
+        m_ingestCount = count;
+        // the culler keeps its own copy on the GPU, refreshed only here
+        if (m_gpuCullingSupported) {
+            m_culler.setObjects(m_ingestObjects, m_ingestCount);
+        }
+    }
+    const CullObject* objects = m_ingestObjects ? m_ingestObjects : m_objects;
+    GLuint objectCount = m_ingestObjects ? m_ingestCount : m_objectCount;
+
+    const GLfloat* color = m_sceneColor;
+    GLuint drawn = 0;
+
+    if (m_gpuCulling) {
+        m_culler.cull(viewProj, lodPixelScale(viewProj, m_width, m_height));
+
+        glUseProgram(m_sceneProgram);
+        glUniformMatrix4fv(m_uSceneMvp, 1, GL_FALSE, viewProj);
+        glUniform4fv(m_uSceneColor, 1, color);
+        glUniform4fv(m_uSceneBounds, 1, m_sceneBounds);
+        glBindVertexArray(m_sceneVao);
+        m_culler.draw(SCENE_INSTANCE_ATTRIB, m_sceneIndexType);
+        glBindVertexArray(0);
+    } else {
+        m_lod.select(objects, objectCount, viewProj, m_width, m_height);
+        glUseProgram(m_sceneProgram);
+        glUniformMatrix4fv(m_uSceneMvp, 1, GL_FALSE, viewProj);
+        glUniform4fv(m_uSceneColor, 1, color);
+        glUniform4fv(m_uSceneBounds, 1, m_sceneBounds);
+        drawn = drawLevels(objects, objectCount);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if ((m_frame++ % 60) == 0) {
+        long us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000L;
+        if (m_gpuCulling) {
+            LOG_INFO("Scene submit (GPU cull): %ld us", us);
+        } else {
+            LOG_INFO("Scene submit (CPU cull): %ld us, %u draws", us, drawn);
+        }
+
+        // the GPU selection is read back, which waits for this frame's
+        // dispatch; once a second is fine
+        CullStats stats;
+        if (m_gpuCulling) {
+            m_culler.readStats(&stats);
+        } else {
+            stats.visible = m_lod.visibleCount();
+            stats.triangles = m_lod.triangleCount();
+            stats.threshold = m_lod.effectiveThreshold();
+            for (GLuint l = 0; l < m_lod.levelCount(); l++) {
+                stats.batchUse[l] = m_lod.levelUseCount(l);
+            }
+        }
+        char use[LOD_MAX_LEVELS * 12] = "";
+        size_t len = 0;
+        for (GLuint l = 0; l < m_lod.levelCount() && len < sizeof(use); l++) {
+            len += snprintf(use + len, sizeof(use) - len, l ? "/%u" : "%u", stats.batchUse[l]);
+        }
+        char threshold[32];
+        if (stats.threshold < FLT_MAX) {
+            snprintf(threshold, sizeof(threshold), "%.2f px", stats.threshold);
+        } else {
+            snprintf(threshold, sizeof(threshold), "coarsest");
+        }
+        LOG_INFO("Scene LOD: %u of %u visible, %u triangles (budget %u), threshold %s, levels %s",
+                 stats.visible, objectCount, stats.triangles, SCENE_TRIANGLE_BUDGET, threshold, use);
+#ifdef LOD_BENCHMARK
+        GLuint pixels = measureCoverage(viewProj, objects, objectCount);
+        LOG_INFO("Scene coverage: %u pixels, %.3f triangles per pixel", pixels,
+                 pixels ? (float) stats.triangles / pixels : 0.0f);
+#endif
+    }
+}
+
+// CPU submission: one draw per visible object at its selected level.
+GLuint Renderer::drawLevels(const CullObject* objects, GLuint objectCount) {
+    const unsigned char* levels = m_lod.levels();
+    GLuint indexSize = m_sceneIndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    GLuint drawn = 0;
+
+    glBindVertexArray(m_sceneVao);
+    for (GLuint i = 0; i < objectCount; i++) {
+        if (levels[i] == LOD_CULLED) {
+            continue;
+        }
+        const CullObject &o = objects[i];
+        const LodLevel &level = m_lod.level(levels[i]);
+        // instance attribute array is disabled, so this is a constant
+        glVertexAttrib4f(SCENE_INSTANCE_ATTRIB, o.center[0], o.center[1], o.center[2], o.radius);
+        glDrawElements(GL_TRIANGLES, level.indexCount, m_sceneIndexType,
+                       (const void*) (uintptr_t) (level.firstIndex * indexSize));
+        drawn++;
+    }
+    glBindVertexArray(0);
+    return drawn;
+}
+
+#ifdef LOD_BENCHMARK
+// Draws the current selection again into a private target and counts the
+// pixels it covers, for comparing triangles submitted against pixels that
+// actually show. Stalls on the read back, so only built for benchmarking.
+GLuint Renderer::measureCoverage(const GLfloat* viewProj, const CullObject* objects, GLuint objectCount) {
+    if (m_coverageWidth != m_width || m_coverageHeight != m_height) {
+        glDeleteFramebuffers(1, &m_coverageFbo);
+        glDeleteRenderbuffers(1, &m_coverageColor);
+        delete[] m_coveragePixels;
+        m_coverageWidth = m_width;
+        m_coverageHeight = m_height;
+        glGenRenderbuffers(1, &m_coverageColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_coverageColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &m_coverageFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_coverageFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_coverageColor);
+        m_coveragePixels = new unsigned char[m_width * m_height * 4];
+    }
+
+    GLint framebuffer = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    const GLfloat white[4] = {
+            1.0f, 1.0f, 1.0f, 1.0f
+    };
+    glBindFramebuffer(GL_FRAMEBUFFER, m_coverageFbo);
+    glViewport(0, 0, m_width, m_height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(m_sceneProgram);
+    glUniformMatrix4fv(m_uSceneMvp, 1, GL_FALSE, viewProj);
+    glUniform4fv(m_uSceneColor, 1, white);
+    glUniform4fv(m_uSceneBounds, 1, m_sceneBounds);
+    if (m_gpuCulling) {
+        glBindVertexArray(m_sceneVao);
+        m_culler.draw(SCENE_INSTANCE_ATTRIB, m_sceneIndexType);
+        glBindVertexArray(0);
+    } else {
+        drawLevels(objects, objectCount);
+    }
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, m_coveragePixels);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    checkGLError("Coverage");
+
+    GLuint pixels = 0;
+    for (GLint i = 0; i < m_width * m_height; i++) {
+        if (m_coveragePixels[i * 4]) {
+            pixels++;
+        }
+    }
+    return pixels;
+}
+#endif
@@ -26,6 +26,11 @@
 #include <EGL/eglext.h>
 
 #include "DrawData.h"
+#include "culling.h"
+#include "rendergraph.h"
+#include "ingest.h"
+#include "meshfile.h"
+#include "lod.h"
 
 
 class Renderer {
@@ -38,9 +43,11 @@ public:
     // They send message to render thread which executes required actions.
     void start();
     void stop();
-    inline void changeMode() { //OPENMSAA = ~OPENMSAA;
-        return;};
+    // Toggles between GPU-driven and CPU-culled scene submission.
+    void changeMode();
     void setWindow(ANativeWindow* window);
+    // Producer side of the scene data triple buffer (see ingest.h).
+    IngestBuffer& ingest() { return m_ingest; }
     
     
 private:
@@ -65,9 +72,7 @@ private:
     GLfloat _angle;
     int m_width;
     int m_height;
-    GLuint m_MSColor;
-    GLuint m_MSFBO;
-    GLuint m_MSDepth;
+    RenderGraph m_graph;
     GLuint m_program;
     GLuint m_vertexShader;
     GLuint m_fragmentShader;
@@ -77,6 +82,40 @@ private:
     GLuint m_p1;
 
    const bool OPENMSAA = true;
+
+    // culling test scene, drawn either through GpuCuller (compute cull +
+    // glDrawElementsIndirect per batch) or CPU-culled with one draw per object
+    GLuint m_sceneProgram;
+    GLint m_uSceneMvp;
+    GLint m_uSceneColor;
+    GLint m_uSceneBounds;
+    GLuint m_sceneVao;
+    GLuint m_sceneVbo;
+    GLuint m_sceneIbo;
+    // SCENE_MESH_PATH when it loads, otherwise the square from DrawData.h
+    MeshFile m_mesh;
+    GLenum m_sceneIndexType;
+    GLfloat m_sceneBounds[4];
+    CullObject* m_objects;
+    GLuint m_objectCount;
+    // scene data published by Java, read in place from the ingest slot
+    IngestBuffer m_ingest;
+    const CullObject* m_ingestObjects;
+    GLuint m_ingestCount;
+    GLfloat m_sceneColor[4];
+    LodSelector m_lod;
+    GpuCuller m_culler;
+    bool m_gpuCullingSupported;
+    bool m_gpuCulling;
+    unsigned int m_frame;
+#ifdef LOD_BENCHMARK
+    // offscreen target for counting the pixels the scene covers
+    GLuint m_coverageFbo;
+    GLuint m_coverageColor;
+    GLint m_coverageWidth;
+    GLint m_coverageHeight;
+    unsigned char* m_coveragePixels;
+#endif
     
     // RenderLoop is called in a rendering thread started in start() method
     // It creates rendering context and renders scene until stop() is called
@@ -85,14 +124,25 @@ private:
     void checkGLError(const char* str);
     
     bool initialize();
-    void MultisampleAntiAliasing();
+    void buildRenderGraph();
     void destroy();
 
     void drawFrame();
+    void mainPass();
     void bindProg();
 
+    void initScene();
+    void initSquare();
+    void destroyScene();
+    void drawScene(const GLfloat* viewProj);
+    GLuint drawLevels(const CullObject* objects, GLuint objectCount);
+#ifdef LOD_BENCHMARK
+    GLuint measureCoverage(const GLfloat* viewProj, const CullObject* objects, GLuint objectCount);
+#endif
+
     // Helper method for starting the thread 
     static void* threadStartCallback(void *myself);
+    static void mainPassCallback(void *myself);
 
     void initShader();
 
@@ -0,0 +1,520 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <GLES3/gl3.h>
+
+#include "logger.h"
+#include "rendergraph.h"
+#include "glcapture.h"
+
+#define LOG_TAG "EglSample"
+
+RenderGraph::RenderGraph()
+        : m_resourceCount(0), m_passCount(0), m_poolCount(0), m_present(-1), m_compiled(false) {
+}
+
+RenderGraph::~RenderGraph() {
+}
+
+void RenderGraph::reset() {
+    releaseFramebuffers();
+    m_resourceCount = 0;
+    m_passCount = 0;
+    m_present = -1;
+    m_compiled = false;
+}
+
+RenderResource RenderGraph::addResource(const char *name, GLsizei width, GLsizei height,
+                                        GLenum format, GLsizei samples, bool backbuffer) {
+    if (m_resourceCount == RG_MAX_RESOURCES) {
+        LOG_ERROR("RenderGraph: too many resources, dropping %s", name);
+        return -1;
+    }
+    Resource &r = m_resources[m_resourceCount];
+    r.name = name;
+    r.width = width;
+    r.height = height;
+    r.format = format;
+    r.samples = samples;
+    r.backbuffer = backbuffer;
+    r.resolve = -1;
+    r.firstUse = -1;
+    r.lastUse = -1;
+    r.lastWriter = -1;
+    r.physical = -1;
+    r.resolveFbo = 0;
+    return m_resourceCount++;
+}
+
+RenderResource RenderGraph::backbuffer(GLsizei width, GLsizei height) {
+    return addResource("backbuffer", width, height, GL_RGBA8, 1, true);
+}
+
+RenderResource RenderGraph::createTarget(const char *name, GLsizei width, GLsizei height,
+                                         GLenum format, GLsizei samples) {
+    return addResource(name, width, height, format, samples > 1 ? samples : 1, false);
+}
+
+int RenderGraph::addPass(const char *name, RenderPassFunc func, void *user) {
+    if (m_passCount == RG_MAX_PASSES) {
+        LOG_ERROR("RenderGraph: too many passes, dropping %s", name);
+        return -1;
+    }
+    Pass &p = m_passes[m_passCount];
+    p.name = name;
+    p.func = func;
+    p.user = user;
+    p.readCount = 0;
+    p.writeCount = 0;
+    p.live = false;
+    p.fbo = 0;
+    m_compiled = false;
+    return m_passCount++;
+}
+
+void RenderGraph::read(int pass, RenderResource res) {
+    if (pass < 0 || res < 0 || m_passes[pass].readCount == RG_MAX_PASS_READS) {
+        LOG_ERROR("RenderGraph: invalid read %d by pass %d", res, pass);
+        return;
+    }
+    Pass &p = m_passes[pass];
+    p.reads[p.readCount++] = res;
+    m_compiled = false;
+}
+
+void RenderGraph::write(int pass, RenderResource res) {
+    if (pass < 0 || res < 0 || m_passes[pass].writeCount == RG_MAX_PASS_WRITES) {
+        LOG_ERROR("RenderGraph: invalid write %d by pass %d", res, pass);
+        return;
+    }
+    Pass &p = m_passes[pass];
+    p.resolves[p.writeCount] = false;
+    p.writes[p.writeCount++] = res;
+    m_compiled = false;
+}
+
+void RenderGraph::present(RenderResource res) {
+    m_present = res;
+    m_compiled = false;
+}
+
+bool RenderGraph::isDepthFormat(GLenum format) {
+    switch (format) {
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+GLenum RenderGraph::attachmentPoint(GLenum format, int colorIndex) {
+    if (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8) {
+        return GL_DEPTH_STENCIL_ATTACHMENT;
+    }
+    if (isDepthFormat(format)) {
+        return GL_DEPTH_ATTACHMENT;
+    }
+    return GL_COLOR_ATTACHMENT0 + colorIndex;
+}
+
+void RenderGraph::releaseFramebuffers() {
+    for (int i = 0; i < m_passCount; i++) {
+        if (m_passes[i].fbo) {
+            glDeleteFramebuffers(1, &m_passes[i].fbo);
+            m_passes[i].fbo = 0;
+        }
+    }
+    for (int i = 0; i < m_resourceCount; i++) {
+        if (m_resources[i].resolveFbo) {
+            glDeleteFramebuffers(1, &m_resources[i].resolveFbo);
+            m_resources[i].resolveFbo = 0;
+        }
+    }
+}
+
+int RenderGraph::acquire(const Resource &res) {
+    // alias: any pooled target of the same shape whose last user finished
+    // before this resource is first written
+    for (int i = 0; i < m_poolCount; i++) {
+        PooledTarget &t = m_pool[i];
+        if (t.name && t.width == res.width && t.height == res.height &&
+            t.format == res.format && t.samples == res.samples && t.lastUse < res.firstUse) {
+            t.lastUse = res.lastUse;
+            t.used = true;
+            return i;
+        }
+    }
+
+    int slot = m_poolCount;
+    for (int i = 0; i < m_poolCount; i++) {
+        if (!m_pool[i].name) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == RG_MAX_RESOURCES) {
+        LOG_ERROR("RenderGraph: target pool exhausted for %s", res.name);
+        return -1;
+    }
+
+    PooledTarget &t = m_pool[slot];
+    t.width = res.width;
+    t.height = res.height;
+    t.format = res.format;
+    t.samples = res.samples;
+    t.renderbuffer = res.samples > 1 || isDepthFormat(res.format);
+    t.lastUse = res.lastUse;
+    t.used = true;
+
+    if (t.renderbuffer) {
+        glGenRenderbuffers(1, &t.name);
+        glBindRenderbuffer(GL_RENDERBUFFER, t.name);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, t.samples > 1 ? t.samples : 0,
+                                         t.format, t.width, t.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    } else {
+        glGenTextures(1, &t.name);
+        glBindTexture(GL_TEXTURE_2D, t.name);
+        glTexStorage2D(GL_TEXTURE_2D, 1, t.format, t.width, t.height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    LOG_INFO("RenderGraph: allocated %s %dx%d fmt 0x%x samples %d for %s",
+             t.renderbuffer ? "renderbuffer" : "texture", t.width, t.height,
+             t.format, t.samples, res.name);
+
+    if (slot == m_poolCount) {
+        m_poolCount++;
+    }
+    return slot;
+}
+
+static void attach(GLenum point, bool renderbuffer, GLuint name) {
+    if (renderbuffer) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, point, GL_RENDERBUFFER, name);
+    } else {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, point, GL_TEXTURE_2D, name, 0);
+    }
+}
+
+bool RenderGraph::compile() {
+    releaseFramebuffers();
+    m_compiled = false;
+
+    if (m_present < 0) {
+        LOG_ERROR("RenderGraph: nothing presented");
+        return false;
+    }
+
+    // cull: walk backwards from the presented resource, keeping only the
+    // passes whose outputs someone downstream consumes
+    bool needed[RG_MAX_RESOURCES];
+    for (int i = 0; i < RG_MAX_RESOURCES; i++) {
+        needed[i] = false;
+    }
+    needed[m_present] = true;
+    for (int p = m_passCount - 1; p >= 0; p--) {
+        Pass &pass = m_passes[p];
+        pass.live = false;
+        for (int w = 0; w < pass.writeCount; w++) {
+            if (needed[pass.writes[w]]) {
+                pass.live = true;
+            }
+        }
+        if (!pass.live) {
+            LOG_INFO("RenderGraph: culled pass %s", pass.name);
+            continue;
+        }
+        for (int r = 0; r < pass.readCount; r++) {
+            needed[pass.reads[r]] = true;
+        }
+    }
+
+    for (int p = 0; p < m_passCount; p++) {
+        for (int w = 0; w < m_passes[p].writeCount; w++) {
+            m_passes[p].resolves[w] = false;
+        }
+    }
+    for (int i = 0; i < m_resourceCount; i++) {
+        m_resources[i].firstUse = -1;
+        m_resources[i].lastUse = -1;
+        m_resources[i].lastWriter = -1;
+        m_resources[i].physical = -1;
+    }
+
+    // lifetimes in pass order; reads of multisampled targets are
+    // redirected to an implicit single sampled resolve target
+    for (int p = 0; p < m_passCount; p++) {
+        Pass &pass = m_passes[p];
+        if (!pass.live) {
+            continue;
+        }
+        if (pass.writeCount == 0) {
+            LOG_ERROR("RenderGraph: pass %s writes nothing", pass.name);
+            return false;
+        }
+        for (int r = 0; r < pass.readCount; r++) {
+            RenderResource res = pass.reads[r];
+            if (m_resources[res].backbuffer || isDepthFormat(m_resources[res].format) ||
+                m_resources[res].lastWriter < 0) {
+                LOG_ERROR("RenderGraph: pass %s cannot read %s", pass.name, m_resources[res].name);
+                return false;
+            }
+            if (m_resources[res].samples > 1) {
+                Resource &src = m_resources[res];
+                if (src.resolve < 0) {
+                    src.resolve = addResource(src.name, src.width, src.height, src.format, 1, false);
+                    if (src.resolve < 0) {
+                        return false;
+                    }
+                }
+                // the resolve blit runs at the end of the pass that wrote
+                // the contents this pass sees, so every writer followed
+                // by a reader gets its own resolve
+                Pass &writer = m_passes[src.lastWriter];
+                for (int w = 0; w < writer.writeCount; w++) {
+                    if (writer.writes[w] == res) {
+                        writer.resolves[w] = true;
+                    }
+                }
+                Resource &dst = m_resources[src.resolve];
+                if (dst.firstUse < 0) {
+                    dst.firstUse = src.lastWriter;
+                }
+                dst.lastWriter = src.lastWriter;
+                res = src.resolve;
+            }
+            m_resources[res].lastUse = p;
+        }
+        for (int w = 0; w < pass.writeCount; w++) {
+            Resource &res = m_resources[pass.writes[w]];
+            if (res.backbuffer && pass.writeCount > 1) {
+                LOG_ERROR("RenderGraph: pass %s mixes backbuffer and targets", pass.name);
+                return false;
+            }
+            if (res.firstUse < 0) {
+                res.firstUse = p;
+            }
+            res.lastUse = p;
+            res.lastWriter = p;
+        }
+    }
+    if (m_resources[m_present].lastWriter < 0) {
+        LOG_ERROR("RenderGraph: presented resource %s is never written", m_resources[m_present].name);
+        return false;
+    }
+    // the final blit to the backbuffer happens after every pass
+    m_resources[m_present].lastUse = m_passCount;
+
+    for (int i = 0; i < m_poolCount; i++) {
+        m_pool[i].lastUse = -1;
+        m_pool[i].used = false;
+    }
+    for (int p = 0; p < m_passCount; p++) {
+        for (int i = 0; i < m_resourceCount; i++) {
+            Resource &res = m_resources[i];
+            if (res.firstUse == p && !res.backbuffer) {
+                res.physical = acquire(res);
+                if (res.physical < 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < m_poolCount; i++) {
+        if (m_pool[i].name && !m_pool[i].used) {
+            if (m_pool[i].renderbuffer) {
+                glDeleteRenderbuffers(1, &m_pool[i].name);
+            } else {
+                glDeleteTextures(1, &m_pool[i].name);
+            }
+            m_pool[i].name = 0;
+            m_pool[i].width = 0;
+        }
+    }
+
+    for (int p = 0; p < m_passCount; p++) {
+        Pass &pass = m_passes[p];
+        if (!pass.live || m_resources[pass.writes[0]].backbuffer) {
+            continue;
+        }
+        glGenFramebuffers(1, &pass.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+        GLenum drawBufs[RG_MAX_PASS_WRITES];
+        int colorCount = 0;
+        for (int w = 0; w < pass.writeCount; w++) {
+            const Resource &res = m_resources[pass.writes[w]];
+            const PooledTarget &t = m_pool[res.physical];
+            GLenum point = attachmentPoint(res.format, colorCount);
+            attach(point, t.renderbuffer, t.name);
+            if (!isDepthFormat(res.format)) {
+                drawBufs[colorCount++] = point;
+            }
+        }
+        glDrawBuffers(colorCount, drawBufs);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR("RenderGraph: pass %s framebuffer incomplete %x", pass.name, status);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return false;
+        }
+    }
+    for (int i = 0; i < m_resourceCount; i++) {
+        Resource &src = m_resources[i];
+        if (src.resolve < 0) {
+            continue;
+        }
+        const Resource &dst = m_resources[src.resolve];
+        glGenFramebuffers(1, &src.resolveFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, src.resolveFbo);
+        attach(attachmentPoint(dst.format, 0), m_pool[dst.physical].renderbuffer, m_pool[dst.physical].name);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_compiled = true;
+    return true;
+}
+
+void RenderGraph::invalidate(const Pass &pass, bool begin) {
+    int index = &pass - m_passes;
+    GLenum attachments[RG_MAX_PASS_WRITES + 1];
+    int count = 0;
+    int colorCount = 0;
+
+    if (m_resources[pass.writes[0]].backbuffer) {
+        // the window depth/stencil is never read back
+        if (!begin) {
+            attachments[count++] = GL_DEPTH;
+            attachments[count++] = GL_STENCIL;
+        }
+    } else {
+        for (int w = 0; w < pass.writeCount; w++) {
+            const Resource &res = m_resources[pass.writes[w]];
+            GLenum point = attachmentPoint(res.format, colorCount);
+            if (!isDepthFormat(res.format)) {
+                colorCount++;
+            }
+            if ((begin && res.firstUse == index) || (!begin && res.lastUse == index)) {
+                attachments[count++] = point;
+            }
+        }
+    }
+    if (count) {
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+    }
+}
+
+void RenderGraph::resolve(const Pass &pass) {
+    int colorCount = 0;
+    for (int w = 0; w < pass.writeCount; w++) {
+        const Resource &res = m_resources[pass.writes[w]];
+        GLenum point = attachmentPoint(res.format, colorCount);
+        if (!isDepthFormat(res.format)) {
+            colorCount++;
+        }
+        if (!pass.resolves[w]) {
+            continue;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, pass.fbo);
+        glReadBuffer(point);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, res.resolveFbo);
+        glBlitFramebuffer(0, 0, res.width, res.height, 0, 0, res.width, res.height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+}
+
+void RenderGraph::execute() {
+    if (!m_compiled) {
+        return;
+    }
+
+    for (int p = 0; p < m_passCount; p++) {
+        const Pass &pass = m_passes[p];
+        if (!pass.live) {
+            continue;
+        }
+        const Resource &target = m_resources[pass.writes[0]];
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+        glViewport(0, 0, target.width, target.height);
+        invalidate(pass, true);
+        pass.func(pass.user);
+        if (pass.fbo) {
+            resolve(pass);
+        }
+        invalidate(pass, false);
+    }
+
+    const Resource &out = m_resources[m_present];
+    if (!out.backbuffer) {
+        const Pass &producer = m_passes[out.lastWriter];
+        int colorCount = 0;
+        GLenum point = GL_COLOR_ATTACHMENT0;
+        for (int w = 0; w < producer.writeCount; w++) {
+            const Resource &res = m_resources[producer.writes[w]];
+            if (producer.writes[w] == m_present) {
+                point = attachmentPoint(res.format, colorCount);
+            }
+            if (!isDepthFormat(res.format)) {
+                colorCount++;
+            }
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, producer.fbo);
+        glReadBuffer(point);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, out.width, out.height, 0, 0, out.width, out.height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glInvalidateFramebuffer(GL_READ_FRAMEBUFFER, 1, &point);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint RenderGraph::texture(RenderResource res) const {
+    if (res < 0) {
+        return 0;
+    }
+    if (m_resources[res].resolve >= 0) {
+        res = m_resources[res].resolve;
+    }
+    int physical = m_resources[res].physical;
+    if (physical < 0 || m_pool[physical].renderbuffer) {
+        return 0;
+    }
+    return m_pool[physical].name;
+}
+
+void RenderGraph::destroy() {
+    releaseFramebuffers();
+    for (int i = 0; i < m_poolCount; i++) {
+        if (!m_pool[i].name) {
+            continue;
+        }
+        if (m_pool[i].renderbuffer) {
+            glDeleteRenderbuffers(1, &m_pool[i].name);
+        } else {
+            glDeleteTextures(1, &m_pool[i].name);
+        }
+    }
+    m_poolCount = 0;
+    m_compiled = false;
+}
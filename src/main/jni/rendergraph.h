@@ -0,0 +1,132 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <GLES3/gl3.h>
+
+#define RG_MAX_PASSES 16
+#define RG_MAX_RESOURCES 32
+#define RG_MAX_PASS_READS 4
+#define RG_MAX_PASS_WRITES 4
+
+// Index of a declared resource, -1 when invalid.
+typedef int RenderResource;
+
+// Called with the pass framebuffer bound and the viewport set to the
+// size of its outputs.
+typedef void (*RenderPassFunc)(void* user);
+
+// Frame graph over transient render targets.
+// Passes declare what they read and write; compile() drops passes that do
+// not contribute to the presented resource, gives every transient target
+// a lifetime and reuses pooled GL objects between targets whose lifetimes
+// do not overlap. Multisampled targets read by later passes are resolved
+// automatically, and attachments are invalidated as soon as their
+// contents are no longer needed so tilers never load or store them.
+class RenderGraph {
+
+public:
+    RenderGraph();
+    virtual ~RenderGraph();
+
+    // Drops the declared passes and resources. Pooled targets are kept so
+    // a rebuilt graph with the same shape reuses them.
+    void reset();
+
+    // Default framebuffer of the current surface.
+    RenderResource backbuffer(GLsizei width, GLsizei height);
+    // Transient target; samples > 1 creates a multisampled renderbuffer,
+    // single sampled color targets are textures so later passes can read them.
+    RenderResource createTarget(const char* name, GLsizei width, GLsizei height,
+                                GLenum format, GLsizei samples);
+
+    int addPass(const char* name, RenderPassFunc func, void* user);
+    void read(int pass, RenderResource res);
+    void write(int pass, RenderResource res);
+    void present(RenderResource res);
+
+    bool compile();
+    void execute();
+    // Frees the pass framebuffers and every pooled target.
+    void destroy();
+
+    // Texture holding the contents of res for a reading pass (the resolved
+    // copy when res is multisampled).
+    GLuint texture(RenderResource res) const;
+
+private:
+
+    struct Resource {
+        const char* name;
+        GLsizei width;
+        GLsizei height;
+        GLenum format;
+        GLsizei samples;
+        bool backbuffer;
+        RenderResource resolve;   // single sampled copy for readers
+        int firstUse;
+        int lastUse;
+        int lastWriter;
+        int physical;             // index into the pool
+        GLuint resolveFbo;
+    };
+
+    struct Pass {
+        const char* name;
+        RenderPassFunc func;
+        void* user;
+        RenderResource reads[RG_MAX_PASS_READS];
+        int readCount;
+        RenderResource writes[RG_MAX_PASS_WRITES];
+        int writeCount;
+        bool resolves[RG_MAX_PASS_WRITES];   // write is read before the next write
+        bool live;
+        GLuint fbo;
+    };
+
+    struct PooledTarget {
+        GLsizei width;
+        GLsizei height;
+        GLenum format;
+        GLsizei samples;
+        bool renderbuffer;
+        GLuint name;
+        int lastUse;
+        bool used;
+    };
+
+    Resource m_resources[RG_MAX_RESOURCES];
+    int m_resourceCount;
+    Pass m_passes[RG_MAX_PASSES];
+    int m_passCount;
+    PooledTarget m_pool[RG_MAX_RESOURCES];
+    int m_poolCount;
+    RenderResource m_present;
+    bool m_compiled;
+
+    RenderResource addResource(const char* name, GLsizei width, GLsizei height,
+                               GLenum format, GLsizei samples, bool backbuffer);
+    int acquire(const Resource& res);
+    void releaseFramebuffers();
+    void invalidate(const Pass& pass, bool begin);
+    void resolve(const Pass& pass);
+    static bool isDepthFormat(GLenum format);
+    static GLenum attachmentPoint(GLenum format, int colorIndex);
+};
+
+#endif // RENDERGRAPH_H
@@ -0,0 +1,734 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Host replayer for captures written by the renderer when built with
+// -DGL_CAPTURE. Replays every recorded call on an offscreen EGL context
+// and reports per-call CPU timing, per-frame timing and state calls that
+// did not change anything.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl31.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glcalls.h"
+
+struct Record {
+    GlCallId id;
+    int argCount;
+    const uint64_t* args;
+    const uint8_t* blob;
+    uint32_t blobSize;
+};
+
+struct CallStats {
+    uint64_t count;
+    uint64_t redundant;
+    uint64_t totalNs;
+    uint64_t maxNs;
+};
+
+typedef std::map<GLuint, GLuint> NameMap;
+
+static std::vector<uint8_t> s_file;
+static std::vector<Record> s_records;
+
+static NameMap s_buffers, s_textures, s_framebuffers, s_renderbuffers, s_vertexArrays;
+static NameMap s_shaders, s_programs;
+static std::map<std::pair<GLuint, GLint>, GLint> s_uniforms;
+static GLuint s_program = 0;        // captured name of the current program
+static GLuint s_vertexArray = 0;
+static GLuint s_arrayBuffer = 0;
+static GLenum s_activeTexture = GL_TEXTURE0;
+static GLuint s_readFramebuffer = 0;
+static GLuint s_drawFramebuffer = 0;
+static std::map<GLenum, void*> s_mappings;  // replay's pointer per mapped target
+
+static CallStats s_stats[GLC_COUNT];
+static std::map<std::vector<uint64_t>, uint64_t> s_state;
+
+static EGLDisplay s_display = EGL_NO_DISPLAY;
+static EGLSurface s_surface = EGL_NO_SURFACE;
+static EGLContext s_context = EGL_NO_CONTEXT;
+
+static uint64_t nowNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static GLuint lookup(const NameMap& map, GLuint name) {
+    NameMap::const_iterator it = map.find(name);
+    return it == map.end() ? name : it->second;
+}
+
+static bool load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    // u64 aligned so arguments can be read in place
+    s_file.resize(((size + 7) & ~7) + 8);
+    size_t got = fread(&s_file[0], 1, size, f);
+    fclose(f);
+    if (got != (size_t) size || size < 8) {
+        fprintf(stderr, "short read on %s\n", path);
+        return false;
+    }
+
+    uint32_t header[2];
+    memcpy(header, &s_file[0], sizeof(header));
+    if (header[0] != GLCAP_MAGIC || header[1] != GLCAP_VERSION) {
+        fprintf(stderr, "%s is not a version %d capture\n", path, GLCAP_VERSION);
+        return false;
+    }
+
+    // records are packed, copy each argument array to aligned storage
+    static std::vector<std::vector<uint64_t> > argStorage;
+    size_t pos = 8;
+    while (pos + 8 <= (size_t) size) {
+        uint16_t head[2];
+        uint32_t blobSize;
+        memcpy(head, &s_file[pos], sizeof(head));
+        memcpy(&blobSize, &s_file[pos + 4], sizeof(blobSize));
+        size_t argBytes = head[1] * sizeof(uint64_t);
+        if (head[0] >= GLC_COUNT || pos + 8 + argBytes + blobSize > (size_t) size) {
+            fprintf(stderr, "corrupt record at offset %zu\n", pos);
+            return false;
+        }
+        argStorage.push_back(std::vector<uint64_t>(head[1] + 1));
+        memcpy(&argStorage.back()[0], &s_file[pos + 8], argBytes);
+
+        Record r;
+        r.id = (GlCallId) head[0];
+        r.argCount = head[1];
+        r.args = &argStorage.back()[0];
+        r.blob = &s_file[pos + 8 + argBytes];
+        r.blobSize = blobSize;
+        s_records.push_back(r);
+        pos += 8 + argBytes + blobSize;
+    }
+    return true;
+}
+
+static bool createContext(EGLint width, EGLint height) {
+    s_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (s_display == EGL_NO_DISPLAY || !eglInitialize(s_display, 0, 0)) {
+        // headless hosts: fall back to Mesa's surfaceless platform
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            s_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+        }
+        if (s_display == EGL_NO_DISPLAY || !eglInitialize(s_display, 0, 0)) {
+            fprintf(stderr, "eglInitialize() failed: 0x%x\n", eglGetError());
+            return false;
+        }
+    }
+
+    const EGLint attribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_BLUE_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_RED_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(s_display, attribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        fprintf(stderr, "eglChooseConfig() failed: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    s_surface = eglCreatePbufferSurface(s_display, config, surfaceAttribs);
+    if (s_surface == EGL_NO_SURFACE) {
+        fprintf(stderr, "eglCreatePbufferSurface() failed: 0x%x\n", eglGetError());
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint contextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION_KHR, 1,
+            EGL_NONE
+    };
+    s_context = eglCreateContext(s_display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (s_context == EGL_NO_CONTEXT) {
+        fprintf(stderr, "eglCreateContext() failed: 0x%x\n", eglGetError());
+        return false;
+    }
+    if (!eglMakeCurrent(s_display, s_surface, s_surface, s_context)) {
+        fprintf(stderr, "eglMakeCurrent() failed: 0x%x\n", eglGetError());
+        return false;
+    }
+    printf("replaying on %s, %s (%dx%d)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION), width, height);
+    return true;
+}
+
+static void destroyContext() {
+    if (s_display == EGL_NO_DISPLAY) {
+        return;
+    }
+    eglMakeCurrent(s_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(s_display, s_context);
+    eglDestroySurface(s_display, s_surface);
+    eglTerminate(s_display);
+}
+
+#define U(i) ((GLuint) a[i])
+#define I(i) ((GLint) (int64_t) a[i])
+#define E(i) ((GLenum) a[i])
+#define SZ(i) ((GLsizeiptr) (int64_t) a[i])
+#define PTR(i) ((const void*) (uintptr_t) a[i])
+
+// Stores value under key; true when it was already there.
+static bool unchanged(const std::vector<uint64_t>& key, uint64_t value) {
+    std::map<std::vector<uint64_t>, uint64_t>::iterator it = s_state.find(key);
+    if (it != s_state.end() && it->second == value) {
+        return true;
+    }
+    s_state[key] = value;
+    return false;
+}
+
+static std::vector<uint64_t> bindingKey(GlCallId group, uint64_t target) {
+    std::vector<uint64_t> key;
+    key.push_back(group);
+    key.push_back(target);
+    return key;
+}
+
+// True when a state call sets exactly what the previous call of its group
+// with the same key arguments already set. The key also holds whatever
+// selects the state the call changes: the current program for uniforms,
+// the active unit for texture bindings, the bound framebuffer for its
+// read and draw buffers and the bound VAO for vertex array state.
+static bool redundant(const Record& r) {
+    const GlCallInfo& info = glCallInfo[r.id];
+    if (info.kind != GLC_STATE && info.kind != GLC_UNIFORM) {
+        return false;
+    }
+    const uint64_t* a = r.args;
+
+    switch (r.id) {
+        case GLC_glBindFramebuffer:
+            // GL_FRAMEBUFFER binds both the read and the draw framebuffer
+            if (E(0) == GL_FRAMEBUFFER) {
+                bool read = unchanged(bindingKey(info.group, GL_READ_FRAMEBUFFER), U(1));
+                bool draw = unchanged(bindingKey(info.group, GL_DRAW_FRAMEBUFFER), U(1));
+                return read && draw;
+            }
+            return unchanged(bindingKey(info.group, E(0)), U(1));
+        case GLC_glBindBufferBase:
+            // also replaces the generic binding of the target
+            s_state[bindingKey(GLC_glBindBuffer, E(0))] = U(2);
+            break;
+        default:
+            break;
+    }
+
+    std::vector<uint64_t> key;
+    key.push_back(info.group);
+    if (info.kind == GLC_UNIFORM) {
+        key.push_back(s_program);
+    }
+    switch (info.group) {
+        case GLC_glBindTexture:
+            key.push_back(s_activeTexture);
+            break;
+        case GLC_glReadBuffer:
+            key.push_back(s_readFramebuffer);
+            break;
+        case GLC_glDrawBuffers:
+            key.push_back(s_drawFramebuffer);
+            break;
+        case GLC_glBindBuffer:
+            if (E(0) == GL_ELEMENT_ARRAY_BUFFER) {
+                key.push_back(s_vertexArray);
+            }
+            break;
+        case GLC_glEnableVertexAttribArray:
+        case GLC_glVertexAttribPointer:
+        case GLC_glVertexAttribDivisor:
+            key.push_back(s_vertexArray);
+            break;
+        default:
+            break;
+    }
+    for (int i = 0; i < info.keyArgs && i < r.argCount; i++) {
+        key.push_back(r.args[i]);
+    }
+    // bindings store the bound name so deletes can forget them
+    switch (r.id) {
+        case GLC_glBindBuffer:
+        case GLC_glBindRenderbuffer:
+        case GLC_glBindTexture:
+            return unchanged(key, U(1));
+        case GLC_glBindBufferBase:
+            return unchanged(key, U(2));
+        case GLC_glBindVertexArray:
+            return unchanged(key, U(0));
+        default:
+            break;
+    }
+
+    // FNV-1a over the call, its arguments and blob
+    uint64_t value = 1469598103934665603ull;
+    const uint8_t* parts[2] = { (const uint8_t*) r.args, r.blob };
+    size_t sizes[2] = { r.argCount * sizeof(uint64_t), r.blobSize };
+    value = (value ^ r.id) * 1099511628211ull;
+    if (r.id == GLC_glVertexAttribPointer) {
+        // the pointer is an offset into whatever GL_ARRAY_BUFFER is bound
+        value = (value ^ s_arrayBuffer) * 1099511628211ull;
+    }
+    for (int p = 0; p < 2; p++) {
+        for (size_t i = 0; i < sizes[p]; i++) {
+            value = (value ^ parts[p][i]) * 1099511628211ull;
+        }
+    }
+    return unchanged(key, value);
+}
+
+// A deleted object is unbound, and its name may be handed out again, so
+// bindings of it (and for a VAO, the state recorded against it) are
+// forgotten.
+static void forget(GlCallId group, GLuint name) {
+    std::map<std::vector<uint64_t>, uint64_t>::iterator it = s_state.begin();
+    while (it != s_state.end()) {
+        const std::vector<uint64_t>& key = it->first;
+        bool drop;
+        if (group == GLC_glBindFramebuffer) {
+            drop = (key[0] == GLC_glBindFramebuffer && it->second == name) ||
+                   ((key[0] == GLC_glReadBuffer || key[0] == GLC_glDrawBuffers) && key[1] == name);
+        } else if (group == GLC_glBindVertexArray) {
+            drop = (key[0] == GLC_glBindVertexArray && it->second == name) ||
+                   ((key[0] == GLC_glEnableVertexAttribArray || key[0] == GLC_glVertexAttribPointer ||
+                     key[0] == GLC_glVertexAttribDivisor ||
+                     (key[0] == GLC_glBindBuffer && key.size() == 3)) && key[1] == name);
+        } else {
+            drop = (key[0] == group || (group == GLC_glBindBuffer && key[0] == GLC_glBindBufferBase)) &&
+                   it->second == name;
+        }
+        if (drop) {
+            s_state.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static void genNames(NameMap& map, const Record& r, void (*gen)(GLsizei, GLuint*)) {
+    GLsizei n = (GLsizei) r.args[0];
+    std::vector<GLuint> names(n);
+    gen(n, &names[0]);
+    for (GLsizei i = 0; i < n; i++) {
+        GLuint captured;
+        memcpy(&captured, r.blob + i * sizeof(GLuint), sizeof(GLuint));
+        map[captured] = names[i];
+    }
+}
+
+static void deleteNames(NameMap& map, const Record& r, void (*del)(GLsizei, const GLuint*),
+                        GlCallId binding) {
+    GLsizei n = (GLsizei) r.args[0];
+    std::vector<GLuint> names(n);
+    for (GLsizei i = 0; i < n; i++) {
+        GLuint captured;
+        memcpy(&captured, r.blob + i * sizeof(GLuint), sizeof(GLuint));
+        names[i] = lookup(map, captured);
+        map.erase(captured);
+        if (captured) {
+            forget(binding, captured);
+        }
+        if (binding == GLC_glBindVertexArray && captured == s_vertexArray) {
+            s_vertexArray = 0;
+        } else if (binding == GLC_glBindBuffer && captured == s_arrayBuffer) {
+            s_arrayBuffer = 0;
+        } else if (binding == GLC_glBindFramebuffer) {
+            if (captured == s_readFramebuffer) {
+                s_readFramebuffer = 0;
+            }
+            if (captured == s_drawFramebuffer) {
+                s_drawFramebuffer = 0;
+            }
+        }
+    }
+    del(n, &names[0]);
+}
+
+static GLfloat F(const uint64_t* a, int i) {
+    uint32_t bits = (uint32_t) a[i];
+    GLfloat f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static GLint location(GLint captured) {
+    if (captured < 0) {
+        return captured;
+    }
+    std::map<std::pair<GLuint, GLint>, GLint>::iterator it =
+            s_uniforms.find(std::make_pair(s_program, captured));
+    return it == s_uniforms.end() ? captured : it->second;
+}
+
+static void replay(const Record& r) {
+    const uint64_t* a = r.args;
+    const GLchar* str = (const GLchar*) r.blob;
+    static GLint scratch[64];
+    static std::vector<unsigned char> pixels;
+    static GLchar log[4096];
+
+    switch (r.id) {
+        case GLC_glActiveTexture:
+            glActiveTexture(E(0));
+            s_activeTexture = E(0);
+            break;
+        case GLC_glAttachShader: glAttachShader(lookup(s_programs, U(0)), lookup(s_shaders, U(1))); break;
+        case GLC_glBindAttribLocation: glBindAttribLocation(lookup(s_programs, U(0)), U(1), str); break;
+        case GLC_glBindBuffer:
+            glBindBuffer(E(0), lookup(s_buffers, U(1)));
+            if (E(0) == GL_ARRAY_BUFFER) {
+                s_arrayBuffer = U(1);
+            }
+            break;
+        case GLC_glBindBufferBase: glBindBufferBase(E(0), U(1), lookup(s_buffers, U(2))); break;
+        case GLC_glBindFramebuffer:
+            glBindFramebuffer(E(0), lookup(s_framebuffers, U(1)));
+            if (E(0) != GL_DRAW_FRAMEBUFFER) {
+                s_readFramebuffer = U(1);
+            }
+            if (E(0) != GL_READ_FRAMEBUFFER) {
+                s_drawFramebuffer = U(1);
+            }
+            break;
+        case GLC_glBindRenderbuffer: glBindRenderbuffer(E(0), lookup(s_renderbuffers, U(1))); break;
+        case GLC_glBindTexture: glBindTexture(E(0), lookup(s_textures, U(1))); break;
+        case GLC_glBindVertexArray:
+            glBindVertexArray(lookup(s_vertexArrays, U(0)));
+            s_vertexArray = U(0);
+            break;
+        case GLC_glBlitFramebuffer:
+            glBlitFramebuffer(I(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7), U(8), E(9));
+            break;
+        case GLC_glBufferData: glBufferData(E(0), SZ(1), r.blobSize ? r.blob : 0, E(3)); break;
+        case GLC_glBufferSubData: glBufferSubData(E(0), SZ(1), SZ(2), r.blob); break;
+        case GLC_glCheckFramebufferStatus: glCheckFramebufferStatus(E(0)); break;
+        case GLC_glClear: glClear(U(0)); break;
+        case GLC_glClearColor: glClearColor(F(a, 0), F(a, 1), F(a, 2), F(a, 3)); break;
+        case GLC_glCompileShader: glCompileShader(lookup(s_shaders, U(0))); break;
+        case GLC_glCreateProgram: s_programs[U(0)] = glCreateProgram(); break;
+        case GLC_glCreateShader: s_shaders[U(1)] = glCreateShader(E(0)); break;
+        case GLC_glDeleteBuffers:
+            deleteNames(s_buffers, r, glDeleteBuffers, GLC_glBindBuffer);
+            break;
+        case GLC_glDeleteFramebuffers:
+            deleteNames(s_framebuffers, r, glDeleteFramebuffers, GLC_glBindFramebuffer);
+            break;
+        case GLC_glDeleteProgram: glDeleteProgram(lookup(s_programs, U(0))); break;
+        case GLC_glDeleteRenderbuffers:
+            deleteNames(s_renderbuffers, r, glDeleteRenderbuffers, GLC_glBindRenderbuffer);
+            break;
+        case GLC_glDeleteShader: glDeleteShader(lookup(s_shaders, U(0))); break;
+        case GLC_glDeleteTextures:
+            deleteNames(s_textures, r, glDeleteTextures, GLC_glBindTexture);
+            break;
+        case GLC_glDeleteVertexArrays:
+            deleteNames(s_vertexArrays, r, glDeleteVertexArrays, GLC_glBindVertexArray);
+            break;
+        case GLC_glDetachShader: glDetachShader(lookup(s_programs, U(0)), lookup(s_shaders, U(1))); break;
+        case GLC_glDisable: glDisable(E(0)); break;
+        case GLC_glDisableVertexAttribArray: glDisableVertexAttribArray(U(0)); break;
+        case GLC_glDispatchCompute: glDispatchCompute(U(0), U(1), U(2)); break;
+        case GLC_glDrawArrays: glDrawArrays(E(0), I(1), I(2)); break;
+        case GLC_glDrawBuffers: glDrawBuffers(I(0), (const GLenum*) r.blob); break;
+        case GLC_glDrawElements:
+            // client memory indices were captured into the blob
+            glDrawElements(E(0), I(1), E(2), r.blobSize ? r.blob : PTR(3));
+            break;
+        case GLC_glDrawElementsIndirect: glDrawElementsIndirect(E(0), E(1), PTR(2)); break;
+        case GLC_glEnable: glEnable(E(0)); break;
+        case GLC_glEnableVertexAttribArray: glEnableVertexAttribArray(U(0)); break;
+        case GLC_glFlush: glFlush(); break;
+        case GLC_glFramebufferRenderbuffer:
+            glFramebufferRenderbuffer(E(0), E(1), E(2), lookup(s_renderbuffers, U(3)));
+            break;
+        case GLC_glFramebufferTexture2D:
+            glFramebufferTexture2D(E(0), E(1), E(2), lookup(s_textures, U(3)), I(4));
+            break;
+        case GLC_glGenBuffers: genNames(s_buffers, r, glGenBuffers); break;
+        case GLC_glGenFramebuffers: genNames(s_framebuffers, r, glGenFramebuffers); break;
+        case GLC_glGenRenderbuffers: genNames(s_renderbuffers, r, glGenRenderbuffers); break;
+        case GLC_glGenTextures: genNames(s_textures, r, glGenTextures); break;
+        case GLC_glGenVertexArrays: genNames(s_vertexArrays, r, glGenVertexArrays); break;
+        case GLC_glGetAttribLocation: glGetAttribLocation(lookup(s_programs, U(0)), str); break;
+        case GLC_glGetError: glGetError(); break;
+        case GLC_glGetIntegerv: glGetIntegerv(E(0), scratch); break;
+        case GLC_glGetProgramInfoLog: glGetProgramInfoLog(lookup(s_programs, U(0)), sizeof(log), 0, log); break;
+        case GLC_glGetProgramiv: glGetProgramiv(lookup(s_programs, U(0)), E(1), scratch); break;
+        case GLC_glGetShaderInfoLog: glGetShaderInfoLog(lookup(s_shaders, U(0)), sizeof(log), 0, log); break;
+        case GLC_glGetShaderiv: glGetShaderiv(lookup(s_shaders, U(0)), E(1), scratch); break;
+        case GLC_glGetString: glGetString(E(0)); break;
+        case GLC_glGetUniformLocation:
+            s_uniforms[std::make_pair(U(0), I(1))] = glGetUniformLocation(lookup(s_programs, U(0)), str);
+            break;
+        case GLC_glInvalidateFramebuffer: glInvalidateFramebuffer(E(0), I(1), (const GLenum*) r.blob); break;
+        case GLC_glLinkProgram: glLinkProgram(lookup(s_programs, U(0))); break;
+        case GLC_glMapBufferRange: s_mappings[E(0)] = glMapBufferRange(E(0), SZ(1), SZ(2), U(3)); break;
+        case GLC_glMemoryBarrier: glMemoryBarrier(U(0)); break;
+        case GLC_glReadBuffer: glReadBuffer(E(0)); break;
+        case GLC_glReadPixels:
+            // the captured pointer means nothing here; read into scratch
+            // space big enough for any format
+            pixels.resize((size_t) I(2) * I(3) * 16);
+            glReadPixels(I(0), I(1), I(2), I(3), E(4), E(5), pixels.data());
+            break;
+        case GLC_glRenderbufferStorage: glRenderbufferStorage(E(0), E(1), I(2), I(3)); break;
+        case GLC_glRenderbufferStorageMultisample:
+            glRenderbufferStorageMultisample(E(0), I(1), E(2), I(3), I(4));
+            break;
+        case GLC_glScissor: glScissor(I(0), I(1), I(2), I(3)); break;
+        case GLC_glShaderSource: glShaderSource(lookup(s_shaders, U(0)), 1, &str, 0); break;
+        case GLC_glTexParameteri: glTexParameteri(E(0), E(1), I(2)); break;
+        case GLC_glTexStorage2D: glTexStorage2D(E(0), I(1), E(2), I(3), I(4)); break;
+        case GLC_glUniform1f: glUniform1f(location(I(0)), F(a, 1)); break;
+        case GLC_glUniform1i: glUniform1i(location(I(0)), I(1)); break;
+        case GLC_glUniform1ui: glUniform1ui(location(I(0)), U(1)); break;
+        case GLC_glUniform2f: glUniform2f(location(I(0)), F(a, 1), F(a, 2)); break;
+        case GLC_glUniform4fv: glUniform4fv(location(I(0)), I(1), (const GLfloat*) r.blob); break;
+        case GLC_glUniformMatrix4fv:
+            glUniformMatrix4fv(location(I(0)), I(1), (GLboolean) U(2), (const GLfloat*) r.blob);
+            break;
+        case GLC_glUnmapBuffer:
+            // a writable mapping carries what the application stored
+            if (r.blobSize && s_mappings[E(0)]) {
+                memcpy(s_mappings[E(0)], r.blob, r.blobSize);
+            }
+            s_mappings.erase(E(0));
+            glUnmapBuffer(E(0));
+            break;
+        case GLC_glUseProgram:
+            glUseProgram(lookup(s_programs, U(0)));
+            s_program = U(0);
+            break;
+        case GLC_glVertexAttrib4f: glVertexAttrib4f(U(0), F(a, 1), F(a, 2), F(a, 3), F(a, 4)); break;
+        case GLC_glVertexAttribDivisor: glVertexAttribDivisor(U(0), U(1)); break;
+        case GLC_glVertexAttribPointer:
+            // client memory pointers are rebound by the ClientArray record
+            // sent with the draw that uses them
+            if (s_vertexArray != 0 || s_arrayBuffer != 0) {
+                glVertexAttribPointer(U(0), I(1), E(2), (GLboolean) U(3), I(4), PTR(5));
+            }
+            break;
+        case GLC_ClientArray:
+            glVertexAttribPointer(U(0), I(1), E(2), (GLboolean) U(3), I(4), r.blob);
+            break;
+        case GLC_eglQuerySurface:
+            break;
+        case GLC_eglSwapBuffers:
+            glFinish();
+            eglSwapBuffers(s_display, s_surface);
+            break;
+        default:
+            break;
+    }
+}
+
+static void printCallTable(uint64_t frames) {
+    std::vector<int> order;
+    for (int i = 0; i < GLC_COUNT; i++) {
+        if (s_stats[i].count) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [](int x, int y) { return s_stats[x].totalNs > s_stats[y].totalNs; });
+
+    printf("\n%-34s %10s %10s %12s %10s %10s\n", "call", "count", "per frame", "total ms", "avg us", "max us");
+    for (size_t i = 0; i < order.size(); i++) {
+        const CallStats& s = s_stats[order[i]];
+        printf("%-34s %10llu %10.1f %12.3f %10.2f %10.2f\n", glCallInfo[order[i]].name,
+               (unsigned long long) s.count, frames ? (double) s.count / frames : 0.0,
+               s.totalNs / 1e6, s.totalNs / 1e3 / s.count, s.maxNs / 1e3);
+    }
+}
+
+static void printRedundancyReport(uint64_t frames) {
+    uint64_t total = 0;
+    uint64_t queries = 0;
+    printf("\nredundant calls (state already set by the previous call):\n");
+    for (int i = 0; i < GLC_COUNT; i++) {
+        if (s_stats[i].redundant) {
+            printf("  %-32s %10llu of %10llu (%5.1f%%)\n", glCallInfo[i].name,
+                   (unsigned long long) s_stats[i].redundant, (unsigned long long) s_stats[i].count,
+                   100.0 * s_stats[i].redundant / s_stats[i].count);
+            total += s_stats[i].redundant;
+        }
+        if (glCallInfo[i].kind == GLC_QUERY) {
+            queries += s_stats[i].count;
+        }
+    }
+    printf("  total %llu redundant calls, %.1f per frame\n", (unsigned long long) total,
+           frames ? (double) total / frames : 0.0);
+    printf("  %llu driver queries, %.1f per frame\n", (unsigned long long) queries,
+           frames ? (double) queries / frames : 0.0);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: glreplay [options] capture.glcap\n"
+            "  --frames N   stop after N frames\n"
+            "  --step       pause after every frame (Enter: next, c: run, q: quit)\n"
+            "  --trace      print every call as it is replayed\n"
+            "  --check      call glGetError() after every call and report failures\n");
+}
+
+int main(int argc, char** argv) {
+    const char* path = 0;
+    long maxFrames = -1;
+    bool step = false;
+    bool trace = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            maxFrames = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--step")) {
+            step = true;
+        } else if (!strcmp(argv[i], "--trace")) {
+            trace = true;
+        } else if (!strcmp(argv[i], "--check")) {
+            check = true;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!path) {
+        usage();
+        return 1;
+    }
+    if (!load(path)) {
+        return 1;
+    }
+
+    EGLint width = 512;
+    EGLint height = 512;
+    for (size_t i = 0; i < s_records.size(); i++) {
+        const Record& r = s_records[i];
+        if (r.id == GLC_eglQuerySurface) {
+            if (r.args[0] == EGL_WIDTH) {
+                width = (EGLint) r.args[1];
+            } else if (r.args[0] == EGL_HEIGHT) {
+                height = (EGLint) r.args[1];
+            }
+        }
+    }
+    printf("%s: %zu calls\n", path, s_records.size());
+    if (!createContext(width, height)) {
+        return 1;
+    }
+
+    uint64_t frames = 0;
+    uint64_t frameCalls = 0;
+    uint64_t frameStart = nowNs();
+    for (size_t i = 0; i < s_records.size(); i++) {
+        const Record& r = s_records[i];
+        CallStats& s = s_stats[r.id];
+
+        if (trace) {
+            printf("%8zu %s(", i, glCallInfo[r.id].name);
+            for (int k = 0; k < r.argCount; k++) {
+                printf(k ? ", 0x%llx" : "0x%llx", (unsigned long long) r.args[k]);
+            }
+            printf(r.blobSize ? ") +%u bytes\n" : ")\n", r.blobSize);
+        }
+
+        if (redundant(r)) {
+            s.redundant++;
+        }
+        uint64_t t0 = nowNs();
+        replay(r);
+        uint64_t dt = nowNs() - t0;
+        s.count++;
+        s.totalNs += dt;
+        if (dt > s.maxNs) {
+            s.maxNs = dt;
+        }
+        frameCalls++;
+
+        if (check) {
+            // outside the timed region so timings stay comparable
+            GLenum error = glGetError();
+            if (error != GL_NO_ERROR) {
+                printf("frame %llu call %zu %s: GL error 0x%x\n", (unsigned long long) frames, i,
+                       glCallInfo[r.id].name, error);
+            }
+        }
+
+        if (r.id != GLC_eglSwapBuffers) {
+            continue;
+        }
+        uint64_t now = nowNs();
+        printf("frame %llu: %llu calls, %.3f ms\n", (unsigned long long) frames,
+               (unsigned long long) frameCalls, (now - frameStart) / 1e6);
+        frames++;
+        frameCalls = 0;
+        if (maxFrames >= 0 && (long) frames >= maxFrames) {
+            break;
+        }
+        if (step) {
+            char line[64];
+            printf("[frame %llu] Enter: next, c: run, q: quit > ", (unsigned long long) frames);
+            fflush(stdout);
+            if (!fgets(line, sizeof(line), stdin) || line[0] == 'q') {
+                break;
+            }
+            if (line[0] == 'c') {
+                step = false;
+            }
+        }
+        frameStart = nowNs();
+    }
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        printf("GL error 0x%x pending after replay\n", error);
+    }
+    printCallTable(frames);
+    printRedundancyReport(frames);
+
+    destroyContext();
+    return 0;
+}
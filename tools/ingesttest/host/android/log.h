@@ -0,0 +1,41 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Host stand-in for the NDK log header so native sources that log
+// through logger.h build on the host; messages go to stderr.
+
+#ifndef HOST_ANDROID_LOG_H
+#define HOST_ANDROID_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+enum {
+    ANDROID_LOG_INFO = 4,
+    ANDROID_LOG_ERROR = 6
+};
+
+static inline int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c/%s: ", prio >= ANDROID_LOG_ERROR ? 'E' : 'I', tag);
+    int n = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return n;
+}
+
+#endif // HOST_ANDROID_LOG_H
@@ -0,0 +1,226 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Host test for IngestBuffer. Walks the slot state machine on one thread,
+// then runs a producer thread against a consuming main thread, the way
+// the Java producer and the render thread use it, and checks that no
+// batch is torn, reordered or lost without being counted.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+
+#include "ingest.h"
+
+#define TEST_BATCHES 20000
+
+static int s_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static int slotIndex(IngestBuffer& buffer, const IngestSlot* slot) {
+    return (int) (slot - (const IngestSlot*) buffer.slotAddress(0));
+}
+
+static void testStates() {
+    IngestBuffer buffer;
+    for (int i = 0; i < INGEST_SLOTS; i++) {
+        CHECK(buffer.state(i) == IngestBuffer::SLOT_FREE);
+    }
+    CHECK(buffer.consume() == 0);
+
+    int a = buffer.acquire();
+    CHECK(a >= 0);
+    CHECK(buffer.state(a) == IngestBuffer::SLOT_WRITING);
+    CHECK(buffer.publish(buffer.slotAddress(a)));
+    CHECK(buffer.state(a) == IngestBuffer::SLOT_READY);
+    CHECK(buffer.published() == 1);
+
+    // only acquired slots, by their exact base address
+    CHECK(!buffer.publish(buffer.slotAddress(a)));
+    CHECK(!buffer.publish((char*) buffer.slotAddress(a) + 1));
+    CHECK(buffer.published() == 1);
+
+    CHECK(buffer.consume() == buffer.slotAddress(a));
+    CHECK(buffer.state(a) == IngestBuffer::SLOT_READING);
+    CHECK(buffer.consume() == 0);
+    CHECK(buffer.state(a) == IngestBuffer::SLOT_READING);
+
+    // one slot read, one waiting: the producer still gets the third
+    int b = buffer.acquire();
+    CHECK(b >= 0 && b != a);
+    CHECK(buffer.publish(buffer.slotAddress(b)));
+    int c = buffer.acquire();
+    CHECK(c >= 0 && c != a && c != b);
+    CHECK(buffer.state(a) == IngestBuffer::SLOT_READING);
+    CHECK(buffer.state(b) == IngestBuffer::SLOT_READY);
+    CHECK(buffer.state(c) == IngestBuffer::SLOT_WRITING);
+
+    // a second acquire before publishing fails instead of taking back the
+    // published slot
+    CHECK(buffer.acquire() == -1);
+    CHECK(buffer.state(b) == IngestBuffer::SLOT_READY);
+    CHECK(buffer.dropped() == 0);
+
+    // publishing over an unconsumed batch drops it
+    CHECK(buffer.publish(buffer.slotAddress(c)));
+    CHECK(buffer.state(b) == IngestBuffer::SLOT_FREE);
+    CHECK(buffer.state(c) == IngestBuffer::SLOT_READY);
+    CHECK(buffer.dropped() == 1);
+
+    // consuming a newer batch releases the one read before
+    CHECK(buffer.consume() == buffer.slotAddress(c));
+    CHECK(buffer.state(a) == IngestBuffer::SLOT_FREE);
+    CHECK(buffer.state(c) == IngestBuffer::SLOT_READING);
+    CHECK(buffer.published() == 3);
+    CHECK(buffer.dropped() == 1);
+}
+
+// Every batch carries its sequence number in params[0] and in each
+// instance, so a slot overwritten while it is read shows up as a mix.
+static void fill(IngestSlot* slot, uint32_t seq) {
+    slot->instanceCount = 1 + seq % 64;
+    slot->paramCount = 1;
+    slot->params[0] = (GLfloat) seq;
+    for (uint32_t i = 0; i < slot->instanceCount; i++) {
+        CullObject& o = slot->instances[i];
+        o.center[0] = (GLfloat) (seq + i);
+        o.center[1] = 0.0f;
+        o.center[2] = 0.0f;
+        o.radius = 1.0f;
+        o.batch = seq;
+    }
+}
+
+static bool consistent(const IngestSlot* slot, uint32_t* seq) {
+    *seq = (uint32_t) slot->params[0];
+    if (slot->paramCount != 1 || slot->instanceCount != 1 + *seq % 64) {
+        return false;
+    }
+    for (uint32_t i = 0; i < slot->instanceCount; i++) {
+        if (slot->instances[i].batch != *seq || slot->instances[i].center[0] != (GLfloat) (*seq + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Producer {
+    IngestBuffer* buffer;
+    std::atomic<bool> done;
+    std::atomic<int> acquireFailures;
+};
+
+static void* producerThread(void* arg) {
+    Producer* p = (Producer*) arg;
+    for (uint32_t seq = 1; seq <= TEST_BATCHES; seq++) {
+        int slot = p->buffer->acquire();
+        if (slot < 0) {
+            p->acquireFailures++;
+            seq--;
+            sched_yield();
+            continue;
+        }
+        fill((IngestSlot*) p->buffer->slotAddress(slot), seq);
+        p->buffer->publish(p->buffer->slotAddress(slot));
+        if (seq % 8 == 0) {
+            sched_yield();
+        }
+    }
+    p->done = true;
+    return 0;
+}
+
+static void testThreads() {
+    IngestBuffer buffer;
+    Producer producer;
+    producer.buffer = &buffer;
+    producer.done = false;
+    producer.acquireFailures = 0;
+
+    pthread_t thread;
+    pthread_create(&thread, 0, producerThread, &producer);
+
+    uint32_t last = 0;
+    unsigned int consumed = 0;
+    unsigned int torn = 0;
+    unsigned int reordered = 0;
+    for (;;) {
+        bool finished = producer.done;
+        const IngestSlot* slot = buffer.consume();
+        if (!slot) {
+            if (finished) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        consumed++;
+
+        uint32_t seq;
+        if (!consistent(slot, &seq)) {
+            torn++;
+            continue;
+        }
+        if (seq <= last) {
+            reordered++;
+        }
+        last = seq;
+
+        // hold the slot like a frame would; the producer must not touch it
+        if (buffer.state(slotIndex(buffer, slot)) != IngestBuffer::SLOT_READING) {
+            torn++;
+        }
+        for (int i = 0; i < 4; i++) {
+            sched_yield();
+        }
+        uint32_t again;
+        if (!consistent(slot, &again) || again != seq) {
+            torn++;
+        }
+    }
+    pthread_join(thread, 0);
+
+    printf("ingesttest: %u published, %u consumed, %u dropped\n",
+           buffer.published(), consumed, buffer.dropped());
+    CHECK(producer.acquireFailures == 0);
+    CHECK(torn == 0);
+    CHECK(reordered == 0);
+    CHECK(last == TEST_BATCHES);
+    CHECK(buffer.published() == TEST_BATCHES);
+    CHECK(consumed + buffer.dropped() == TEST_BATCHES);
+}
+
+int main() {
+    testStates();
+    testThreads();
+    if (s_failures) {
+        fprintf(stderr, "ingesttest: %d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("ingesttest: ok\n");
+    return 0;
+}
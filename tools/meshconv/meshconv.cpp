@@ -0,0 +1,725 @@
+//
+// Copyright 2011 Tero Saarni
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Offline converter from Wavefront OBJ to the binary mesh container read
+// by MeshFile (see meshformat.h). Builds a LOD chain by vertex clustering,
+// orders every LOD for the post-transform vertex cache, splits the LODs
+// into meshlets and quantizes the vertices.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "meshformat.h"
+
+struct Vertex {
+    float p[3];
+    float n[3];
+    float t[2];
+};
+
+struct Lod {
+    std::vector<uint32_t> indices;
+    std::vector<MeshMeshlet> meshlets;
+    float error;
+};
+
+static std::vector<Vertex> s_vertices;
+static std::vector<uint32_t> s_indices;
+
+// --- OBJ ---------------------------------------------------------------
+
+// Resolves a 1-based (or negative, relative) OBJ index; -1 when absent.
+static int objIndex(const char* s, size_t count) {
+    if (!*s) {
+        return -1;
+    }
+    long i = strtol(s, 0, 10);
+    if (i < 0) {
+        i += (long) count;
+    } else {
+        i -= 1;
+    }
+    return (i >= 0 && (size_t) i < count) ? (int) i : -2;
+}
+
+static bool loadObj(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    std::vector<float> positions, normals, texcoords;
+    std::map<std::tuple<int, int, int>, uint32_t> unique;
+    std::vector<int> vertexPosition;  // position index of every vertex
+    std::vector<bool> hasNormal;
+    char line[4096];
+    int lineNo = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char* s = line;
+        while (*s == ' ' || *s == '\t') {
+            s++;
+        }
+        float x = 0, y = 0, z = 0;
+        if (!strncmp(s, "v ", 2)) {
+            sscanf(s + 2, "%f %f %f", &x, &y, &z);
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+        } else if (!strncmp(s, "vn ", 3)) {
+            sscanf(s + 3, "%f %f %f", &x, &y, &z);
+            normals.push_back(x);
+            normals.push_back(y);
+            normals.push_back(z);
+        } else if (!strncmp(s, "vt ", 3)) {
+            sscanf(s + 3, "%f %f", &x, &y);
+            texcoords.push_back(x);
+            texcoords.push_back(y);
+        } else if (!strncmp(s, "f ", 2)) {
+            // polygons are triangulated as a fan around the first corner
+            std::vector<uint32_t> face;
+            for (char* tok = strtok(s + 2, " \t\r\n"); tok; tok = strtok(0, " \t\r\n")) {
+                char* vt = strchr(tok, '/');
+                char* vn = vt ? strchr(vt + 1, '/') : 0;
+                if (vt) {
+                    *vt++ = 0;
+                }
+                if (vn) {
+                    *vn++ = 0;
+                }
+                int pi = objIndex(tok, positions.size() / 3);
+                int ti = vt ? objIndex(vt, texcoords.size() / 2) : -1;
+                int ni = vn ? objIndex(vn, normals.size() / 3) : -1;
+                if (pi < 0 || ti < -1 || ni < -1) {
+                    fprintf(stderr, "%s:%d: bad face index\n", path, lineNo);
+                    fclose(f);
+                    return false;
+                }
+                std::tuple<int, int, int> key(pi, ti, ni);
+                std::map<std::tuple<int, int, int>, uint32_t>::iterator it = unique.find(key);
+                if (it == unique.end()) {
+                    Vertex v;
+                    memset(&v, 0, sizeof(v));
+                    memcpy(v.p, &positions[pi * 3], sizeof(v.p));
+                    if (ti >= 0) {
+                        memcpy(v.t, &texcoords[ti * 2], sizeof(v.t));
+                    }
+                    if (ni >= 0) {
+                        memcpy(v.n, &normals[ni * 3], sizeof(v.n));
+                    }
+                    it = unique.insert(std::make_pair(key, (uint32_t) s_vertices.size())).first;
+                    s_vertices.push_back(v);
+                    vertexPosition.push_back(pi);
+                    hasNormal.push_back(ni >= 0);
+                }
+                face.push_back(it->second);
+            }
+            for (size_t i = 2; i < face.size(); i++) {
+                s_indices.push_back(face[0]);
+                s_indices.push_back(face[i - 1]);
+                s_indices.push_back(face[i]);
+            }
+        }
+    }
+    fclose(f);
+
+    // smooth, area weighted normals for corners the file left without one
+    std::vector<float> accum(positions.size(), 0.0f);
+    for (size_t i = 0; i < s_indices.size(); i += 3) {
+        const float* a = s_vertices[s_indices[i]].p;
+        const float* b = s_vertices[s_indices[i + 1]].p;
+        const float* c = s_vertices[s_indices[i + 2]].p;
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                      e1[2] * e2[0] - e1[0] * e2[2],
+                      e1[0] * e2[1] - e1[1] * e2[0]};
+        for (int k = 0; k < 3; k++) {
+            int pi = vertexPosition[s_indices[i + k]];
+            accum[pi * 3] += n[0];
+            accum[pi * 3 + 1] += n[1];
+            accum[pi * 3 + 2] += n[2];
+        }
+    }
+    for (size_t i = 0; i < s_vertices.size(); i++) {
+        float* n = s_vertices[i].n;
+        if (!hasNormal[i]) {
+            memcpy(n, &accum[vertexPosition[i] * 3], 3 * sizeof(float));
+        }
+        float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len > 0.0f) {
+            n[0] /= len;
+            n[1] /= len;
+            n[2] /= len;
+        } else {
+            n[2] = 1.0f;
+        }
+    }
+    return !s_indices.empty();
+}
+
+// --- LOD chain -----------------------------------------------------------
+
+// Drops triangles that collapsed or duplicate an earlier one.
+static void cleanTriangles(std::vector<uint32_t>& indices) {
+    std::set<std::tuple<uint32_t, uint32_t, uint32_t> > seen;
+    size_t out = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        // rotate so the smallest index leads, keeping the winding
+        uint32_t key[3] = {a, b, c};
+        int first = (a < b) ? (a < c ? 0 : 2) : (b < c ? 1 : 2);
+        std::tuple<uint32_t, uint32_t, uint32_t> t(key[first], key[(first + 1) % 3], key[(first + 2) % 3]);
+        if (!seen.insert(t).second) {
+            continue;
+        }
+        indices[out++] = a;
+        indices[out++] = b;
+        indices[out++] = c;
+    }
+    indices.resize(out);
+}
+
+// Vertex clustering on a grid of the given resolution along the longest
+// axis. Every cell collapses to the original vertex nearest the cell's
+// average, so all LODs keep sharing one vertex array. The error is the
+// largest distance a vertex moved.
+static void simplify(const std::vector<uint32_t>& source, const float lo[3], float cellSize,
+                     std::vector<uint32_t>& result, float& error) {
+    std::map<std::tuple<int, int, int>, std::vector<uint32_t> > cells;
+    std::vector<bool> used(s_vertices.size(), false);
+    for (size_t i = 0; i < source.size(); i++) {
+        used[source[i]] = true;
+    }
+    for (uint32_t v = 0; v < s_vertices.size(); v++) {
+        if (!used[v]) {
+            continue;
+        }
+        const float* p = s_vertices[v].p;
+        std::tuple<int, int, int> c((int) floorf((p[0] - lo[0]) / cellSize),
+                                    (int) floorf((p[1] - lo[1]) / cellSize),
+                                    (int) floorf((p[2] - lo[2]) / cellSize));
+        cells[c].push_back(v);
+    }
+
+    std::vector<uint32_t> remap(s_vertices.size(), 0);
+    error = 0.0f;
+    for (std::map<std::tuple<int, int, int>, std::vector<uint32_t> >::iterator it = cells.begin();
+         it != cells.end(); ++it) {
+        const std::vector<uint32_t>& members = it->second;
+        float avg[3] = {0, 0, 0};
+        for (size_t i = 0; i < members.size(); i++) {
+            for (int k = 0; k < 3; k++) {
+                avg[k] += s_vertices[members[i]].p[k] / members.size();
+            }
+        }
+        uint32_t best = members[0];
+        float bestDist = 1e30f;
+        for (size_t i = 0; i < members.size(); i++) {
+            const float* p = s_vertices[members[i]].p;
+            float d = (p[0] - avg[0]) * (p[0] - avg[0]) + (p[1] - avg[1]) * (p[1] - avg[1]) +
+                      (p[2] - avg[2]) * (p[2] - avg[2]);
+            if (d < bestDist) {
+                bestDist = d;
+                best = members[i];
+            }
+        }
+        const float* r = s_vertices[best].p;
+        for (size_t i = 0; i < members.size(); i++) {
+            const float* p = s_vertices[members[i]].p;
+            float d = sqrtf((p[0] - r[0]) * (p[0] - r[0]) + (p[1] - r[1]) * (p[1] - r[1]) +
+                            (p[2] - r[2]) * (p[2] - r[2]));
+            error = std::max(error, d);
+            remap[members[i]] = best;
+        }
+    }
+
+    result.resize(source.size());
+    for (size_t i = 0; i < source.size(); i++) {
+        result[i] = remap[source[i]];
+    }
+    cleanTriangles(result);
+}
+
+// --- vertex cache --------------------------------------------------------
+
+#define CACHE_SIZE 32
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" scoring.
+static float vertexScore(int cachePosition, int remaining) {
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = 0.75f;
+        } else {
+            score = powf(1.0f - (cachePosition - 3) * (1.0f / (CACHE_SIZE - 3)), 1.5f);
+        }
+    }
+    return score + 2.0f * powf((float) remaining, -0.5f);
+}
+
+static void optimizeVertexCache(std::vector<uint32_t>& indices) {
+    size_t triCount = indices.size() / 3;
+    size_t vertexCount = s_vertices.size();
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        remaining[indices[i]]++;
+    }
+    std::vector<uint32_t> offset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offset[v + 1] = offset[v] + remaining[v];
+    }
+    std::vector<uint32_t> vertexTris(indices.size());
+    std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        vertexTris[fill[indices[i]]++] = (uint32_t) (i / 3);
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<bool> emitted(triCount, false);
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    size_t scan = 0;
+    long best = -1;
+
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            // nothing in the cache has triangles left, restart from the
+            // first triangle not emitted yet
+            while (emitted[scan]) {
+                scan++;
+            }
+            best = (long) scan;
+        }
+        emitted[best] = true;
+        const uint32_t* tri = &indices[best * 3];
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = tri[k];
+            result.push_back(v);
+            remaining[v]--;
+            // drop the triangle from the vertex's list
+            uint32_t* list = &vertexTris[offset[v]];
+            for (uint32_t i = 0; i <= remaining[v]; i++) {
+                if (list[i] == (uint32_t) best) {
+                    std::swap(list[i], list[remaining[v]]);
+                    break;
+                }
+            }
+        }
+
+        // move the triangle's vertices to the front of the LRU cache
+        std::vector<uint32_t> next(tri, tri + 3);
+        for (size_t i = 0; i < cache.size(); i++) {
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2]) {
+                next.push_back(cache[i]);
+            }
+        }
+        for (size_t i = CACHE_SIZE; i < next.size(); i++) {
+            cachePos[next[i]] = -1;
+            score[next[i]] = vertexScore(-1, remaining[next[i]]);
+        }
+        if (next.size() > CACHE_SIZE) {
+            next.resize(CACHE_SIZE);
+        }
+        cache.swap(next);
+
+        // rescore the cached vertices and pick the best triangle among
+        // the ones they touch
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePos[cache[i]] = (int) i;
+            score[cache[i]] = vertexScore((int) i, remaining[cache[i]]);
+        }
+        for (size_t i = 0; i < cache.size(); i++) {
+            uint32_t v = cache[i];
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = vertexTris[offset[v] + j];
+                float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (s > bestScore) {
+                    bestScore = s;
+                    best = (long) t;
+                }
+            }
+        }
+    }
+    indices.swap(result);
+}
+
+// Average cache miss ratio (transformed vertices per triangle) of a FIFO
+// cache of the given size, the usual model of mobile vertex caches.
+static float acmr(const std::vector<uint32_t>& indices, size_t cacheSize) {
+    std::vector<uint32_t> fifo;
+    size_t misses = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (std::find(fifo.begin(), fifo.end(), indices[i]) == fifo.end()) {
+            misses++;
+            fifo.push_back(indices[i]);
+            if (fifo.size() > cacheSize) {
+                fifo.erase(fifo.begin());
+            }
+        }
+    }
+    return indices.empty() ? 0.0f : (float) misses / (indices.size() / 3);
+}
+
+// --- meshlets ------------------------------------------------------------
+
+static void buildMeshlets(const std::vector<uint32_t>& indices, uint32_t firstIndex,
+                          std::vector<MeshMeshlet>& meshlets) {
+    std::vector<uint32_t> verts;
+    size_t start = 0;
+    for (size_t i = 0; i <= indices.size(); i += 3) {
+        bool flush = i == indices.size();
+        if (!flush) {
+            size_t added = 0;
+            for (int k = 0; k < 3; k++) {
+                if (std::find(verts.begin(), verts.end(), indices[i + k]) == verts.end()) {
+                    added++;
+                }
+            }
+            flush = verts.size() + added > MESH_MESHLET_MAX_VERTICES ||
+                    (i - start) / 3 >= MESH_MESHLET_MAX_TRIANGLES;
+        }
+        if (flush && i > start) {
+            MeshMeshlet m;
+            memset(&m, 0, sizeof(m));
+            m.firstIndex = firstIndex + (uint32_t) start;
+            m.indexCount = (uint32_t) (i - start);
+            for (size_t v = 0; v < verts.size(); v++) {
+                for (int k = 0; k < 3; k++) {
+                    m.center[k] += s_vertices[verts[v]].p[k] / verts.size();
+                }
+            }
+            for (size_t v = 0; v < verts.size(); v++) {
+                const float* p = s_vertices[verts[v]].p;
+                float d = sqrtf((p[0] - m.center[0]) * (p[0] - m.center[0]) +
+                                (p[1] - m.center[1]) * (p[1] - m.center[1]) +
+                                (p[2] - m.center[2]) * (p[2] - m.center[2]));
+                m.radius = std::max(m.radius, d);
+            }
+            meshlets.push_back(m);
+            verts.clear();
+            start = i;
+        }
+        if (i < indices.size()) {
+            for (int k = 0; k < 3; k++) {
+                if (std::find(verts.begin(), verts.end(), indices[i + k]) == verts.end()) {
+                    verts.push_back(indices[i + k]);
+                }
+            }
+        }
+    }
+}
+
+// --- quantization --------------------------------------------------------
+
+static uint16_t toHalf(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exp = (int32_t) ((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    if (exp <= 0) {
+        if (exp < -10) {
+            return (uint16_t) sign;
+        }
+        // subnormal, round to nearest
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t) (14 - exp);
+        uint32_t h = mant >> shift;
+        if ((mant >> (shift - 1)) & 1) {
+            h++;
+        }
+        return (uint16_t) (sign | h);
+    }
+    if (exp >= 31) {
+        return (uint16_t) (sign | 0x7c00);
+    }
+    uint32_t h = sign | ((uint32_t) exp << 10) | (mant >> 13);
+    // round to nearest; a carry into the exponent is still correct
+    if (mant & 0x1000) {
+        h++;
+    }
+    return (uint16_t) h;
+}
+
+static int16_t toSnorm16(float f) {
+    f = std::max(-1.0f, std::min(1.0f, f));
+    return (int16_t) lrintf(f * 32767.0f);
+}
+
+// Octahedral normal encoding (Meyer et al.), decoded in the vertex shader.
+static void octEncode(const float n[3], int16_t out[2]) {
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = n[0] / l1;
+    float y = n[1] / l1;
+    if (n[2] < 0.0f) {
+        float ox = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float oy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = ox;
+        y = oy;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+// --- output --------------------------------------------------------------
+
+static uint32_t align(uint32_t offset) {
+    return (offset + MESH_ALIGN - 1) & ~(uint32_t) (MESH_ALIGN - 1);
+}
+
+static bool writeMesh(const char* path, const std::vector<Lod>& lods, bool index32,
+                      const float center[3], float radius) {
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lodTable;
+    std::vector<MeshMeshlet> meshlets;
+    for (size_t i = 0; i < lods.size(); i++) {
+        MeshLod l;
+        memset(&l, 0, sizeof(l));
+        l.firstIndex = (uint32_t) indices.size();
+        l.indexCount = (uint32_t) lods[i].indices.size();
+        l.firstMeshlet = (uint32_t) meshlets.size();
+        l.meshletCount = (uint32_t) lods[i].meshlets.size();
+        l.error = lods[i].error;
+        lodTable.push_back(l);
+        indices.insert(indices.end(), lods[i].indices.begin(), lods[i].indices.end());
+        meshlets.insert(meshlets.end(), lods[i].meshlets.begin(), lods[i].meshlets.end());
+    }
+
+    MeshFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = MESH_MAGIC;
+    h.version = MESH_VERSION;
+    h.indexSize = index32 ? 4 : 2;
+    h.vertexCount = (uint32_t) s_vertices.size();
+    h.indexCount = (uint32_t) indices.size();
+    h.lodCount = (uint32_t) lodTable.size();
+    h.meshletCount = (uint32_t) meshlets.size();
+    h.vertexOffset = align(sizeof(MeshFileHeader));
+    h.indexOffset = align(h.vertexOffset + h.vertexCount * sizeof(MeshVertex));
+    h.lodOffset = align(h.indexOffset + h.indexCount * h.indexSize);
+    h.meshletOffset = align(h.lodOffset + h.lodCount * sizeof(MeshLod));
+    h.fileSize = h.meshletOffset + h.meshletCount * sizeof(MeshMeshlet);
+    memcpy(h.center, center, sizeof(h.center));
+    h.radius = radius;
+
+    std::vector<uint8_t> file(h.fileSize, 0);
+    memcpy(&file[0], &h, sizeof(h));
+    MeshVertex* out = (MeshVertex*) &file[h.vertexOffset];
+    for (size_t i = 0; i < s_vertices.size(); i++) {
+        const Vertex& v = s_vertices[i];
+        for (int k = 0; k < 3; k++) {
+            out[i].position[k] = toHalf(v.p[k]);
+        }
+        out[i].position[3] = toHalf(1.0f);
+        octEncode(v.n, out[i].normal);
+        out[i].texcoord[0] = toHalf(v.t[0]);
+        out[i].texcoord[1] = toHalf(v.t[1]);
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+        // the loader rejects files with out of range indices; catch a
+        // broken remap here rather than on the device
+        if (indices[i] >= h.vertexCount) {
+            fprintf(stderr, "index %u at %zu is past the %u vertices\n", indices[i], i, h.vertexCount);
+            return false;
+        }
+        if (index32) {
+            ((uint32_t*) &file[h.indexOffset])[i] = indices[i];
+        } else {
+            ((uint16_t*) &file[h.indexOffset])[i] = (uint16_t) indices[i];
+        }
+    }
+    memcpy(&file[h.lodOffset], &lodTable[0], lodTable.size() * sizeof(MeshLod));
+    if (!meshlets.empty()) {
+        memcpy(&file[h.meshletOffset], &meshlets[0], meshlets.size() * sizeof(MeshMeshlet));
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "cannot create %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(&file[0], 1, file.size(), f) == file.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "write to %s failed\n", path);
+    }
+    return ok;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: meshconv [options] input.obj output.mesh\n"
+            "  --lods N     build at most N LODs including the full mesh (default %d)\n"
+            "  --index32    always write 32 bit indices\n",
+            MESH_MAX_LODS);
+}
+
+int main(int argc, char** argv) {
+    int maxLods = MESH_MAX_LODS;
+    bool index32 = false;
+    const char* input = 0;
+    const char* output = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--lods") && i + 1 < argc) {
+            maxLods = std::max(1, std::min(MESH_MAX_LODS, atoi(argv[++i])));
+        } else if (!strcmp(argv[i], "--index32")) {
+            index32 = true;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else if (!input) {
+            input = argv[i];
+        } else if (!output) {
+            output = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!input || !output) {
+        usage();
+        return 1;
+    }
+    size_t len = strlen(input);
+    if (len < 4 || strcasecmp(input + len - 4, ".obj") != 0) {
+        fprintf(stderr, "%s: only Wavefront OBJ input is supported\n", input);
+        return 1;
+    }
+    if (!loadObj(input)) {
+        fprintf(stderr, "%s: no triangles\n", input);
+        return 1;
+    }
+
+    float lo[3] = {1e30f, 1e30f, 1e30f};
+    float hi[3] = {-1e30f, -1e30f, -1e30f};
+    for (size_t i = 0; i < s_vertices.size(); i++) {
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], s_vertices[i].p[k]);
+            hi[k] = std::max(hi[k], s_vertices[i].p[k]);
+        }
+    }
+    if (std::max(std::max(fabsf(lo[0]), fabsf(hi[0])), std::max(std::max(fabsf(lo[1]), fabsf(hi[1])),
+                 std::max(fabsf(lo[2]), fabsf(hi[2])))) > 65504.0f) {
+        fprintf(stderr, "%s: positions exceed the half float range\n", input);
+        return 1;
+    }
+    float center[3] = {(lo[0] + hi[0]) * 0.5f, (lo[1] + hi[1]) * 0.5f, (lo[2] + hi[2]) * 0.5f};
+    float radius = 0.0f;
+    for (size_t i = 0; i < s_vertices.size(); i++) {
+        const float* p = s_vertices[i].p;
+        radius = std::max(radius, sqrtf((p[0] - center[0]) * (p[0] - center[0]) +
+                                        (p[1] - center[1]) * (p[1] - center[1]) +
+                                        (p[2] - center[2]) * (p[2] - center[2])));
+    }
+    float extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+
+    // LOD 0 is the full mesh; every further level clusters it on a coarser
+    // grid until the triangle count has roughly halved
+    std::vector<Lod> lods(1);
+    lods[0].indices = s_indices;
+    cleanTriangles(lods[0].indices);
+    lods[0].error = 0.0f;
+    float grid = 256.0f;
+    while ((int) lods.size() < maxLods && grid >= 2.0f) {
+        size_t previous = lods.back().indices.size();
+        if (previous / 3 <= 16) {
+            break;
+        }
+        Lod lod;
+        while (grid >= 2.0f) {
+            simplify(lods[0].indices, lo, extent / grid, lod.indices, lod.error);
+            grid *= 0.5f;
+            if (lod.indices.size() <= previous * 6 / 10) {
+                break;
+            }
+        }
+        if (lod.indices.empty() || lod.indices.size() >= previous) {
+            break;
+        }
+        lods.push_back(lod);
+    }
+
+    printf("%s: %zu vertices, %zu triangles\n", input, s_vertices.size(), lods[0].indices.size() / 3);
+    for (size_t i = 0; i < lods.size(); i++) {
+        float before = acmr(lods[i].indices, 16);
+        optimizeVertexCache(lods[i].indices);
+        printf("  LOD %zu: %7zu triangles, error %.5f, ACMR %.3f -> %.3f\n", i,
+               lods[i].indices.size() / 3, lods[i].error, before, acmr(lods[i].indices, 16));
+    }
+
+    // order vertices by first use so LOD 0 fetches memory front to back,
+    // and drop the ones no LOD references
+    std::vector<uint32_t> remap(s_vertices.size(), UINT32_MAX);
+    std::vector<Vertex> ordered;
+    for (size_t l = 0; l < lods.size(); l++) {
+        for (size_t i = 0; i < lods[l].indices.size(); i++) {
+            uint32_t& v = lods[l].indices[i];
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = (uint32_t) ordered.size();
+                ordered.push_back(s_vertices[v]);
+            }
+            v = remap[v];
+        }
+    }
+    s_vertices.swap(ordered);
+    if (s_vertices.size() > 0xffff && !index32) {
+        index32 = true;
+    }
+
+    uint32_t firstIndex = 0;
+    size_t meshletCount = 0;
+    for (size_t i = 0; i < lods.size(); i++) {
+        buildMeshlets(lods[i].indices, firstIndex, lods[i].meshlets);
+        firstIndex += (uint32_t) lods[i].indices.size();
+        meshletCount += lods[i].meshlets.size();
+    }
+
+    if (!writeMesh(output, lods, index32, center, radius)) {
+        return 1;
+    }
+    printf("%s: %zu LODs, %zu meshlets, %d bit indices\n", output, lods.size(), meshletCount,
+           index32 ? 32 : 16);
+    return 0;
+}